@@ -0,0 +1,267 @@
+/*
+Copyright (c) 2020
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* microbenchmark for libpiano’s blowfish/hex codec: compares
+ * PianoEncryptString and PianoDecryptString with the previous
+ * snprintf/strtol implementation on playlist- and station info-sized
+ * payloads, and counts the heap allocations one rpc request needs with
+ * and without the per-request arena. Run with `make bench-crypt`. */
+
+#include "../src/config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "crypt.h"
+
+#define KEY "6#26FRL$ZWD"
+
+static double now (void) {
+	struct timespec t;
+	clock_gettime (CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/*	json-like payload of roughly size bytes
+ */
+static char *makePayload (const size_t size) {
+	char * const buf = malloc (size + 128);
+	size_t pos = 0;
+	unsigned int i = 0;
+	pos += sprintf (buf, "{\"items\":[");
+	while (pos < size) {
+		pos += sprintf (buf + pos, "{\"artistName\":\"Artist %u\","
+				"\"songName\":\"Song %u\",\"trackToken\":\"%08x%08x\"},",
+				i, i * 7, i * 2654435761u, i);
+		++i;
+	}
+	strcpy (buf + pos - 1, "]}");
+	return buf;
+}
+
+/* the previous implementation, for comparison */
+static char *oldEncrypt (gcry_cipher_hd_t h, const char *s) {
+	const size_t inputLen = strlen (s);
+	const size_t paddedLen = (inputLen % 8 == 0) ? inputLen :
+			inputLen + (8 - inputLen % 8);
+	unsigned char * const padded = calloc (paddedLen + 1, 1);
+	memcpy (padded, s, inputLen);
+	gcry_cipher_encrypt (h, padded, paddedLen, NULL, 0);
+	char * const out = calloc (paddedLen * 2 + 1, 1);
+	for (size_t i = 0; i < paddedLen; i++) {
+		snprintf (&out[i*2], 3, "%02x", padded[i]);
+	}
+	free (padded);
+	return out;
+}
+
+static char *oldDecrypt (gcry_cipher_hd_t h, const char * const input,
+		size_t * const retSize) {
+	const size_t outputLen = strlen (input) / 2;
+	unsigned char * const output = calloc (outputLen + 1, 1);
+	for (size_t i = 0; i < outputLen; i++) {
+		char hex[3];
+		memcpy (hex, &input[i*2], 2);
+		hex[2] = '\0';
+		output[i] = strtol (hex, NULL, 16);
+	}
+	gcry_cipher_decrypt (h, output, outputLen, NULL, 0);
+	*retSize = outputLen;
+	return (char *) output;
+}
+
+/* largest chunk libcurl hands to the write callback */
+#define CHUNK (16*1024)
+
+/*	collect a response of len bytes like httpFetchCb in src/rpc.c,
+ *	length < 0 if the server sent no Content-Length
+ */
+static PianoArena_t *receive (const char * const body, const size_t len,
+		const long length) {
+	PianoArena_t *arena = NULL;
+	char *data = NULL;
+	size_t pos = 0, size = 0;
+
+	while (pos < len) {
+		const size_t recvSize = len - pos < CHUNK ? len - pos : CHUNK;
+		if (pos + recvSize + 1 > size) {
+			size_t newSize;
+			if (size == 0) {
+				newSize = length > 0 ? (size_t) length + 1 : 16*1024;
+				if (newSize < pos + recvSize + 1) {
+					newSize = pos + recvSize + 1;
+				}
+			} else {
+				newSize = size * 2;
+				while (newSize < pos + recvSize + 1) {
+					newSize *= 2;
+				}
+			}
+			if (arena == NULL) {
+				arena = PianoArenaNew (newSize);
+			}
+			data = PianoArenaRealloc (arena, data, pos, newSize);
+			size = newSize;
+		}
+		memcpy (data + pos, body + pos, recvSize);
+		pos += recvSize;
+		data[pos] = '\0';
+	}
+	return arena;
+}
+
+/*	print heap allocations for one request with a response of size bytes:
+ *	the previous malloc/realloc scheme, then the arena with and without
+ *	Content-Length
+ */
+static void allocs (gcry_cipher_hd_t h, const char * const name,
+		const size_t size) {
+	char * const request = makePayload (300);
+	char * const response = makePayload (size);
+	const size_t requestLen = strlen (request), len = strlen (response);
+	size_t counts[2];
+
+	/* strdup’d post data, padded input and hex output, then one malloc or
+	 * realloc per chunk received */
+	const size_t old = 3 + (len + CHUNK - 1) / CHUNK;
+
+	for (size_t i = 0; i < 2; i++) {
+		size_t n, blocks, bytes;
+		PianoArena_t * const arena = PianoArenaNew (requestLen*4+32);
+		PianoArenaStrdup (arena, request);
+		PianoEncryptString (h, request, arena);
+		PianoArena_t * const body = receive (response, len,
+				i == 0 ? -1 : (long) len);
+		PianoArenaAdopt (arena, body);
+		PianoArenaStats (arena, &n, &blocks, &bytes);
+		/* plus one for each arena header */
+		counts[i] = blocks + 2;
+		PianoArenaDestroy (arena);
+	}
+
+	printf ("%-14s %8zu %10zu %10zu %10zu\n", name, len, old, counts[0],
+			counts[1]);
+
+	free (request);
+	free (response);
+}
+
+static void bench (gcry_cipher_hd_t h, const char * const name,
+		const size_t size) {
+	char * const payload = makePayload (size);
+	const size_t len = strlen (payload);
+	/* about 16 MB per measurement */
+	const unsigned int rounds = 16 * 1024 * 1024 / len + 1;
+	double t;
+
+	/* check both implementations agree */
+	PianoArena_t * const check = PianoArenaNew (len * 2 + 16);
+	char * const enc = PianoEncryptString (h, payload, check);
+	char * const oldEnc = oldEncrypt (h, payload);
+	size_t decLen;
+	char * const dec = PianoDecryptString (h, enc, &decLen);
+	if (strcmp (enc, oldEnc) != 0 || strcmp (dec, payload) != 0) {
+		fprintf (stderr, "%s: mismatch\n", name);
+		exit (EXIT_FAILURE);
+	}
+	free (oldEnc);
+	free (dec);
+
+	/* a bad digit is rejected in the vectorized part and in the tail */
+	const size_t encLen = strlen (enc);
+	const size_t bad[] = {0, 17, encLen / 2, encLen - 1};
+	for (size_t i = 0; i < sizeof (bad) / sizeof (*bad); i++) {
+		const char orig = enc[bad[i]];
+		enc[bad[i]] = 'g';
+		char * const invalid = PianoDecryptString (h, enc, &decLen);
+		if (invalid != NULL) {
+			fprintf (stderr, "%s: invalid hex accepted at %zu\n", name,
+					bad[i]);
+			exit (EXIT_FAILURE);
+		}
+		enc[bad[i]] = orig;
+	}
+
+	t = now ();
+	for (unsigned int i = 0; i < rounds; i++) {
+		PianoArena_t * const arena = PianoArenaNew (len * 2 + 16);
+		PianoEncryptString (h, payload, arena);
+		PianoArenaDestroy (arena);
+	}
+	const double encNew = len * (double) rounds / (now () - t) / 1e6;
+
+	t = now ();
+	for (unsigned int i = 0; i < rounds; i++) {
+		free (oldEncrypt (h, payload));
+	}
+	const double encOld = len * (double) rounds / (now () - t) / 1e6;
+
+	t = now ();
+	for (unsigned int i = 0; i < rounds; i++) {
+		free (PianoDecryptString (h, enc, &decLen));
+	}
+	const double decNew = len * (double) rounds / (now () - t) / 1e6;
+
+	t = now ();
+	for (unsigned int i = 0; i < rounds; i++) {
+		free (oldDecrypt (h, enc, &decLen));
+	}
+	const double decOld = len * (double) rounds / (now () - t) / 1e6;
+
+	printf ("%-14s %8zu %10.1f %10.1f %10.1f %10.1f\n", name, len, encOld,
+			encNew, decOld, decNew);
+
+	PianoArenaDestroy (check);
+	free (payload);
+}
+
+int main (void) {
+	gcry_cipher_hd_t h;
+
+	if (gcry_cipher_open (&h, GCRY_CIPHER_BLOWFISH, GCRY_CIPHER_MODE_ECB,
+			0) != GPG_ERR_NO_ERROR || gcry_cipher_setkey (h, KEY,
+			strlen (KEY)) != GPG_ERR_NO_ERROR) {
+		fprintf (stderr, "libgcrypt initialization failed\n");
+		return EXIT_FAILURE;
+	}
+
+	printf ("%-14s %8s %21s %21s\n", "", "", "encrypt MB/s", "decrypt MB/s");
+	printf ("%-14s %8s %10s %10s %10s %10s\n", "payload", "bytes", "old", "new",
+			"old", "new");
+	bench (h, "request", 300);
+	bench (h, "playlist", 8 * 1024);
+	bench (h, "station info", 64 * 1024);
+	bench (h, "large", 1024 * 1024);
+
+	printf ("\n%-14s %8s %32s\n", "", "", "mallocs per request");
+	printf ("%-14s %8s %10s %10s %10s\n", "response", "bytes", "old",
+			"arena", "+length");
+	allocs (h, "playlist", 8 * 1024);
+	allocs (h, "station info", 64 * 1024);
+	allocs (h, "large", 1024 * 1024);
+
+	gcry_cipher_close (h);
+	return EXIT_SUCCESS;
+}
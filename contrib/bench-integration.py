@@ -0,0 +1,235 @@
+#!/usr/bin/env python3
+"""
+Drive pianobar against mock-pandora.py and report latencies.
+
+Each run starts a fresh mock server and a fresh pianobar with an empty
+configuration directory, waits until --songs songs have started playing and
+quits. Per-rpc latencies are taken from the mock’s request log, client side
+milestones (login, station list, first song) from pianobar’s event_command.
+Audio is sent to libao’s null driver.
+"""
+
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+CONTRIB = os.path.dirname (os.path.abspath (__file__))
+
+EVENTCMD = '''#!/bin/sh
+echo "$1" > '{fifo}'
+cat > /dev/null
+'''
+
+
+def percentile (values, p):
+	if not values:
+		return float ('nan')
+	values = sorted (values)
+	k = (len (values) - 1) * p
+	lo = int (k)
+	hi = min (lo + 1, len (values) - 1)
+	return values[lo] + (values[hi] - values[lo]) * (k - lo)
+
+
+def makeCert (workdir):
+	key = os.path.join (workdir, 'mock.key')
+	crt = os.path.join (workdir, 'mock.crt')
+	subprocess.run (['openssl', 'req', '-x509', '-newkey', 'rsa:2048',
+			'-nodes', '-keyout', key, '-out', crt, '-days', '1',
+			'-subj', '/CN=127.0.0.1', '-addext', 'subjectAltName=IP:127.0.0.1'],
+			check=True, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+	pem = os.path.join (workdir, 'mock.pem')
+	with open (pem, 'w') as fd:
+		for f in (key, crt):
+			with open (f) as src:
+				fd.write (src.read ())
+	return pem, crt
+
+
+class EventReader (threading.Thread):
+	""" Timestamp events written to a fifo by the event command. """
+
+	def __init__ (self, path):
+		super ().__init__ (daemon=True)
+		# O_RDWR keeps the fifo open between writers
+		self.fd = os.open (path, os.O_RDWR)
+		self.events = []
+		self.cond = threading.Condition ()
+
+	def run (self):
+		with os.fdopen (self.fd, 'r') as fd:
+			for line in fd:
+				with self.cond:
+					self.events.append ((time.monotonic (), line.strip ()))
+					self.cond.notify_all ()
+
+	def waitFor (self, event, count, timeout):
+		deadline = time.monotonic () + timeout
+		with self.cond:
+			while sum (1 for _, e in self.events if e == event) < count:
+				left = deadline - time.monotonic ()
+				if left <= 0:
+					return False
+				self.cond.wait (left)
+		return True
+
+	def first (self, event):
+		with self.cond:
+			for t, e in self.events:
+				if e == event:
+					return t
+		return None
+
+
+def run (args, n, pem, crt):
+	workdir = tempfile.mkdtemp (prefix='pianobar-bench-')
+	confdir = os.path.join (workdir, 'config', 'pianobar')
+	os.makedirs (confdir)
+	log = os.path.join (workdir, 'mock.log')
+
+	mockArgs = [sys.executable, os.path.join (CONTRIB, 'mock-pandora.py'),
+			'--cert', pem, '--log', log,
+			'--latency', str (args.latency), '--jitter', str (args.jitter),
+			'--audio-latency', str (args.audio_latency),
+			'--error-rate', str (args.error_rate),
+			'--song-length', str (args.song_length), '--seed', str (n)]
+	mock = subprocess.Popen (mockArgs, stdout=subprocess.PIPE, text=True)
+	ports = dict (kv.split ('=') for kv in mock.stdout.readline ().split ())
+
+	eventFifo = os.path.join (workdir, 'events')
+	os.mkfifo (eventFifo)
+	events = EventReader (eventFifo)
+	events.start ()
+	eventCmd = os.path.join (workdir, 'eventcmd.sh')
+	with open (eventCmd, 'w') as fd:
+		fd.write (EVENTCMD.format (fifo=eventFifo))
+	os.chmod (eventCmd, 0o755)
+
+	ctl = os.path.join (confdir, 'ctl')
+	os.mkfifo (ctl)
+	with open (os.path.join (confdir, 'config'), 'w') as fd:
+		fd.write ('\n'.join ([
+				'user = bench@example.com',
+				'password = bench',
+				'rpc_host = 127.0.0.1',
+				'rpc_port = %s' % ports['port'],
+				'rpc_tls_port = %s' % ports['tls_port'],
+				'ca_bundle = %s' % crt,
+				'autostart_station = 1000',
+				'event_command = %s' % eventCmd,
+				'fifo = %s' % ctl,
+				'persist_auth = 0',
+				'',
+				]))
+	with open (os.path.join (workdir, '.libao'), 'w') as fd:
+		fd.write ('default_driver=null\n')
+
+	env = dict (os.environ, HOME=workdir,
+			XDG_CONFIG_HOME=os.path.join (workdir, 'config'))
+	start = time.monotonic ()
+	pianobar = subprocess.Popen ([args.pianobar], env=env,
+			stdin=subprocess.DEVNULL, stdout=subprocess.DEVNULL,
+			stderr=subprocess.DEVNULL)
+	complete = events.waitFor ('songstart', args.songs, args.timeout)
+	with open (ctl, 'w') as fd:
+		fd.write ('q\n')
+	try:
+		pianobar.wait (timeout=10)
+	except subprocess.TimeoutExpired:
+		pianobar.kill ()
+		pianobar.wait ()
+	mock.terminate ()
+	mock.wait ()
+
+	def since (event):
+		t = events.first (event)
+		return None if t is None else (t - start) * 1000
+
+	with open (log) as fd:
+		requests = [json.loads (l) for l in fd]
+	if not args.keep:
+		shutil.rmtree (workdir)
+
+	return {
+			'complete': complete,
+			'login_ms': since ('userlogin'),
+			'stations_ms': since ('usergetstations'),
+			'first_audio_ms': since ('songstart'),
+			'requests': requests,
+			}
+
+
+def summarize (results, out):
+	perMethod = {}
+	errors = 0
+	for r in results:
+		for req in r['requests']:
+			name = req['method'] if req['kind'] == 'rpc' else 'audio'
+			perMethod.setdefault (name, []).append (req['latency_ms'])
+			if req.get ('stat') == 'fail':
+				errors += 1
+
+	out.write ('%-36s %6s %9s %9s %9s %9s\n' % ('request', 'count', 'mean',
+			'p50', 'p95', 'max'))
+	for name, lat in sorted (perMethod.items ()):
+		out.write ('%-36s %6i %9.2f %9.2f %9.2f %9.2f\n' % (name, len (lat),
+				sum (lat) / len (lat), percentile (lat, 0.5),
+				percentile (lat, 0.95), max (lat)))
+	out.write ('%i failed rpcs\n\n' % errors)
+
+	for key in ('login_ms', 'stations_ms', 'first_audio_ms'):
+		values = [r[key] for r in results if r[key] is not None]
+		out.write ('%-36s %6i %9.2f %9.2f %9.2f %9.2f\n' % (key, len (values),
+				sum (values) / len (values) if values else float ('nan'),
+				percentile (values, 0.5), percentile (values, 0.95),
+				max (values) if values else float ('nan')))
+	incomplete = sum (1 for r in results if not r['complete'])
+	if incomplete:
+		out.write ('%i runs timed out\n' % incomplete)
+	return incomplete == 0
+
+
+def main ():
+	parser = argparse.ArgumentParser (description=__doc__.split ('\n\n')[0],
+			formatter_class=argparse.ArgumentDefaultsHelpFormatter)
+	parser.add_argument ('pianobar', nargs='?', default='./pianobar')
+	parser.add_argument ('--runs', type=int, default=5)
+	parser.add_argument ('--songs', type=int, default=2,
+			help='songs to play per run')
+	parser.add_argument ('--song-length', type=int, default=2,
+			help='seconds')
+	parser.add_argument ('--latency', type=float, default=50,
+			help='rpc latency in ms')
+	parser.add_argument ('--jitter', type=float, default=20,
+			help='extra rpc latency in ms')
+	parser.add_argument ('--audio-latency', type=float, default=20,
+			help='audio latency in ms')
+	parser.add_argument ('--error-rate', type=float, default=0)
+	parser.add_argument ('--timeout', type=float, default=60,
+			help='seconds per run')
+	parser.add_argument ('--json', help='write raw results here')
+	parser.add_argument ('--keep', action='store_true',
+			help='keep temporary directories')
+	args = parser.parse_args ()
+
+	certdir = tempfile.mkdtemp (prefix='pianobar-bench-')
+	try:
+		pem, crt = makeCert (certdir)
+		results = [run (args, n, pem, crt) for n in range (args.runs)]
+	finally:
+		shutil.rmtree (certdir)
+
+	if args.json:
+		with open (args.json, 'w') as fd:
+			json.dump (results, fd, indent=1)
+	sys.exit (0 if summarize (results, sys.stdout) else 1)
+
+
+if __name__ == '__main__':
+	main ()
@@ -0,0 +1,93 @@
+/*
+Copyright (c) 2020
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* microbenchmark for building libpiano lists: compares appending with
+ * PianoListAppend, which walks the whole list for every element, to
+ * PianoListPush on a PianoList_t. Run with `make bench-list`. */
+
+#include "../src/config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "piano.h"
+
+static double now (void) {
+	struct timespec t;
+	clock_gettime (CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void bench (const size_t n) {
+	PianoStation_t * const stations = calloc (n, sizeof (*stations));
+	PianoStation_t *l = NULL;
+
+	double start = now ();
+	for (size_t i = 0; i < n; i++) {
+		l = PianoListAppendP (l, &stations[i]);
+	}
+	const size_t oldCount = PianoListCountP (l);
+	const double old = now () - start;
+
+	for (size_t i = 0; i < n; i++) {
+		stations[i].head.next = NULL;
+	}
+
+	start = now ();
+	PianoList_t list;
+	PianoListInit (&list, NULL);
+	for (size_t i = 0; i < n; i++) {
+		l = PianoListPushP (&list, &stations[i]);
+	}
+	const size_t newCount = list.count;
+	const double new = now () - start;
+
+	/* both must produce the same list */
+	PianoStation_t *curr = l;
+	size_t i = 0;
+	PianoListForeachP (curr) {
+		if (curr != &stations[i]) {
+			break;
+		}
+		++i;
+	}
+	if (i != n || oldCount != n || newCount != n) {
+		fprintf (stderr, "list mismatch for %zu elements\n", n);
+		exit (EXIT_FAILURE);
+	}
+
+	printf ("%8zu %12.3f %12.3f %10.0fx\n", n, old * 1000, new * 1000,
+			new > 0 ? old / new : 0);
+	free (stations);
+}
+
+int main (void) {
+	printf ("%8s %12s %12s %11s\n", "elements", "append ms", "push ms",
+			"speedup");
+	bench (100);
+	bench (1000);
+	bench (10000);
+	bench (50000);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,443 @@
+#!/usr/bin/env python3
+"""
+Mock pandora json api server for hermetic integration and load tests.
+
+Speaks the same blowfish-encrypted protocol as tuner.pandora.com, using
+pianobar’s inkey/outkey, and serves synthetic stations, playlists and audio
+files on localhost. Latency and errors can be injected. Every request is
+logged as one json object per line to --log.
+
+Point pianobar at it with
+
+    rpc_host = 127.0.0.1
+    rpc_port = <http port>
+    rpc_tls_port = <https port>
+    ca_bundle = <certificate passed to --cert>
+
+The listening ports are printed to stdout once the server is ready.
+"""
+
+import argparse
+import io
+import json
+import math
+import random
+import ssl
+import struct
+import sys
+import threading
+import time
+import wave
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import urlsplit, parse_qs
+
+# pianobar’s defaults, see settings.c
+DEFAULT_INKEY = 'R=U!LH$O2B#'
+DEFAULT_OUTKEY = '6#26FRL$ZWD'
+
+# pandora error codes, see PianoReturn_t
+E_INTERNAL = 0
+E_INVALID_AUTH_TOKEN = 1001
+E_INVALID_PARTNER_LOGIN = 1002
+E_STATION_DOES_NOT_EXIST = 1006
+
+
+def piDigits (words):
+	""" First `words` 32 bit words of pi’s fractional part, which make up
+	blowfish’s initial P-array and S-boxes. """
+	bits = 32*words + 64
+	one = 1 << bits
+
+	def arctanInv (x):
+		total = term = one // x
+		x2 = x*x
+		k = 3
+		sign = -1
+		while term:
+			term //= x2
+			total += sign * (term // k)
+			sign = -sign
+			k += 2
+		return total
+
+	pi = 16*arctanInv (5) - 4*arctanInv (239)
+	frac = (pi - (3 << bits)) >> 64
+	return [(frac >> (32*(words-1-i))) & 0xffffffff for i in range (words)]
+
+
+_PI = piDigits (18 + 4*256)
+
+
+class Blowfish:
+	""" Blowfish in ECB mode, big endian, as used by libgcrypt. """
+
+	def __init__ (self, key):
+		key = key.encode ('utf-8')
+		self.p = list (_PI[:18])
+		self.s = [list (_PI[18+i*256:18+(i+1)*256]) for i in range (4)]
+
+		pos = 0
+		for i in range (18):
+			k = 0
+			for _ in range (4):
+				k = (k << 8) | key[pos % len (key)]
+				pos += 1
+			self.p[i] ^= k
+
+		l = r = 0
+		for i in range (0, 18, 2):
+			l, r = self._encryptBlock (l, r)
+			self.p[i], self.p[i+1] = l, r
+		for box in self.s:
+			for i in range (0, 256, 2):
+				l, r = self._encryptBlock (l, r)
+				box[i], box[i+1] = l, r
+
+	def _f (self, x):
+		s = self.s
+		h = (s[0][x >> 24] + s[1][(x >> 16) & 0xff]) & 0xffffffff
+		return ((h ^ s[2][(x >> 8) & 0xff]) + s[3][x & 0xff]) & 0xffffffff
+
+	def _encryptBlock (self, l, r):
+		p = self.p
+		for i in range (16):
+			l ^= p[i]
+			r ^= self._f (l)
+			l, r = r, l
+		l, r = r, l
+		r ^= p[16]
+		l ^= p[17]
+		return l, r
+
+	def _decryptBlock (self, l, r):
+		p = self.p
+		for i in range (17, 1, -1):
+			l ^= p[i]
+			r ^= self._f (l)
+			l, r = r, l
+		l, r = r, l
+		r ^= p[1]
+		l ^= p[0]
+		return l, r
+
+	def encrypt (self, data):
+		""" Zero-pad, encrypt and hex-encode, like PianoEncryptString. """
+		if len (data) % 8:
+			data += b'\0' * (8 - len (data) % 8)
+		out = bytearray ()
+		for i in range (0, len (data), 8):
+			l, r = struct.unpack ('>II', data[i:i+8])
+			out += struct.pack ('>II', *self._encryptBlock (l, r))
+		return out.hex ()
+
+	def decrypt (self, hexdata):
+		""" Hex-decode and decrypt, like PianoDecryptString. """
+		data = bytes.fromhex (hexdata)
+		out = bytearray ()
+		for i in range (0, len (data) - len (data) % 8, 8):
+			l, r = struct.unpack ('>II', data[i:i+8])
+			out += struct.pack ('>II', *self._decryptBlock (l, r))
+		return bytes (out)
+
+
+def makeAudio (seconds, rate=22050):
+	""" Mono 16 bit wav file with a sine tone. """
+	buf = io.BytesIO ()
+	w = wave.open (buf, 'wb')
+	w.setnchannels (1)
+	w.setsampwidth (2)
+	w.setframerate (rate)
+	frames = bytearray ()
+	for i in range (int (seconds*rate)):
+		v = int (8000 * math.sin (2*math.pi*440*i/rate))
+		frames += struct.pack ('<h', v)
+	w.writeframes (bytes (frames))
+	w.close ()
+	return buf.getvalue ()
+
+
+class Catalog:
+	""" Synthetic stations and songs. """
+
+	def __init__ (self, stations, songsPerPlaylist, songLength):
+		self.stations = [{
+				'stationName': 'Station %i' % i,
+				'stationToken': str (1000+i),
+				'stationId': str (1000+i),
+				'isShared': False,
+				'isQuickMix': False,
+				} for i in range (stations)]
+		self.stations.append ({
+				'stationName': 'QuickMix',
+				'stationToken': '999',
+				'stationId': '999',
+				'isShared': False,
+				'isQuickMix': True,
+				'quickMixStationIds': [s['stationToken'] for s in self.stations],
+				})
+		self.songsPerPlaylist = songsPerPlaylist
+		self.songLength = songLength
+		self.nextTrack = 0
+		self.lock = threading.Lock ()
+
+	def station (self, token):
+		for s in self.stations:
+			if s['stationToken'] == token:
+				return s
+		return None
+
+	def playlist (self, station, baseUrl):
+		items = []
+		for _ in range (self.songsPerPlaylist):
+			with self.lock:
+				n = self.nextTrack
+				self.nextTrack += 1
+			url = '%s/audio/%i.wav' % (baseUrl, n)
+			items.append ({
+					'artistName': 'Artist %i' % (n % 17),
+					'albumName': 'Album %i' % (n % 5),
+					'songName': 'Song %i' % n,
+					'trackToken': 't%i' % n,
+					'stationId': station['stationToken'],
+					'albumArtUrl': '',
+					'songDetailUrl': '',
+					'trackGain': '0.0',
+					'trackLength': self.songLength,
+					'songRating': 0,
+					'audioUrlMap': {q: {'encoding': 'mp3', 'audioUrl': url}
+							for q in ('lowQuality', 'mediumQuality',
+							'highQuality')},
+					})
+		return {'items': items}
+
+
+class MockState:
+	def __init__ (self, args):
+		self.args = args
+		self.inCipher = Blowfish (args.inkey)
+		self.outCipher = Blowfish (args.outkey)
+		self.catalog = Catalog (args.stations, args.playlist_size,
+				args.song_length)
+		self.audio = makeAudio (args.song_length)
+		self.partnerTokens = set ()
+		self.userTokens = set ()
+		self.nextToken = 0
+		self.lock = threading.Lock ()
+		self.log = open (args.log, 'a') if args.log else None
+		self.random = random.Random (args.seed)
+		self.httpUrl = None
+
+	def token (self, kind):
+		with self.lock:
+			self.nextToken += 1
+			return '%s%08x' % (kind, self.nextToken)
+
+	def record (self, entry):
+		if self.log is None:
+			return
+		with self.lock:
+			self.log.write (json.dumps (entry) + '\n')
+			self.log.flush ()
+
+	def delay (self, base, jitter):
+		with self.lock:
+			d = base + self.random.uniform (0, jitter)
+		if d > 0:
+			time.sleep (d/1000)
+
+	def injectError (self):
+		with self.lock:
+			return self.random.random () < self.args.error_rate
+
+
+def ok (result=None):
+	ret = {'stat': 'ok'}
+	if result is not None:
+		ret['result'] = result
+	return ret
+
+
+def fail (code, message):
+	return {'stat': 'fail', 'code': code, 'message': message}
+
+
+class Handler (BaseHTTPRequestHandler):
+	protocol_version = 'HTTP/1.1'
+	server_version = 'mock-pandora/1'
+
+	def log_message (self, fmt, *args):
+		if self.server.state.args.verbose:
+			super ().log_message (fmt, *args)
+
+	def reply (self, code, body, contentType):
+		self.send_response (code)
+		self.send_header ('Content-Type', contentType)
+		self.send_header ('Content-Length', str (len (body)))
+		self.end_headers ()
+		self.wfile.write (body)
+
+	def do_GET (self):
+		state = self.server.state
+		start = time.time ()
+		path = urlsplit (self.path).path
+		if not path.startswith ('/audio/'):
+			self.reply (404, b'not found\n', 'text/plain')
+			return
+		state.delay (state.args.audio_latency, 0)
+		self.reply (200, state.audio, 'audio/wav')
+		state.record ({'time': start, 'kind': 'audio', 'path': path,
+				'latency_ms': (time.time () - start)*1000})
+
+	def do_POST (self):
+		state = self.server.state
+		start = time.time ()
+		url = urlsplit (self.path)
+		query = parse_qs (url.query)
+		method = query.get ('method', [''])[0]
+		length = int (self.headers.get ('Content-Length', 0))
+		body = self.rfile.read (length).decode ('ascii', 'replace')
+
+		state.delay (state.args.latency, state.args.jitter)
+		if state.injectError ():
+			resp = fail (state.args.error_code, 'Injected error')
+		else:
+			resp = self.dispatch (state, method, body)
+		self.reply (200, json.dumps (resp).encode ('utf-8'),
+				'application/json')
+		state.record ({'time': start, 'kind': 'rpc', 'method': method,
+				'secure': isinstance (self.connection, ssl.SSLSocket),
+				'stat': resp['stat'], 'code': resp.get ('code'),
+				'bytes': length, 'latency_ms': (time.time () - start)*1000})
+
+	def dispatch (self, state, method, body):
+		if method == 'auth.partnerLogin':
+			try:
+				j = json.loads (body)
+			except ValueError:
+				return fail (E_INTERNAL, 'Invalid request')
+			if j.get ('username') is None:
+				return fail (E_INVALID_PARTNER_LOGIN, 'Invalid partner login')
+			token = state.token ('P')
+			with state.lock:
+				state.partnerTokens.add (token)
+			sync = b'\x00\x00\x00\x00' + str (int (time.time ())).encode ()
+			return ok ({
+					'partnerAuthToken': token,
+					'partnerId': '42',
+					'syncTime': state.inCipher.encrypt (sync),
+					})
+
+		try:
+			plain = state.outCipher.decrypt (body).rstrip (b'\0')
+			j = json.loads (plain.decode ('utf-8'))
+		except ValueError:
+			return fail (E_INTERNAL, 'Invalid request')
+
+		if method == 'auth.userLogin':
+			with state.lock:
+				known = j.get ('partnerAuthToken') in state.partnerTokens
+			if not known or j.get ('username') is None:
+				return fail (E_INVALID_PARTNER_LOGIN, 'Invalid login')
+			token = state.token ('U')
+			with state.lock:
+				state.userTokens.add (token)
+			return ok ({'userId': '1', 'userAuthToken': token})
+
+		with state.lock:
+			known = j.get ('userAuthToken') in state.userTokens
+		if not known:
+			return fail (E_INVALID_AUTH_TOKEN, 'Invalid auth token')
+
+		catalog = state.catalog
+		if method == 'user.getStationList':
+			return ok ({'stations': catalog.stations})
+		elif method == 'station.getPlaylist':
+			station = catalog.station (j.get ('stationToken'))
+			if station is None:
+				return fail (E_STATION_DOES_NOT_EXIST, 'No such station')
+			return ok (catalog.playlist (station, state.httpUrl))
+		elif method == 'station.getGenreStations':
+			return ok ({'categories': [{
+					'categoryName': 'Genre %i' % c,
+					'stations': [{'stationName': 'Genre %i-%i' % (c, i),
+							'stationToken': 'G%i-%i' % (c, i)}
+							for i in range (5)],
+					} for c in range (3)]})
+		elif method == 'station.getStation':
+			return ok ({'music': {'songs': [], 'artists': []},
+					'feedback': {'thumbsUp': [], 'thumbsDown': []}})
+		elif method == 'music.search':
+			return ok ({'artists': [], 'songs': []})
+		elif method == 'track.explainTrack':
+			return ok ({'explanations': []})
+		elif method.startswith ('interactiveradio.'):
+			return ok ({'currentModeId': 0, 'availableModes': []})
+		elif method in ('station.createStation',
+				'station.transformSharedStation'):
+			station = dict (catalog.stations[0])
+			station['stationName'] = 'New station'
+			return ok (station)
+		else:
+			# feedback, bookmarks, settings and friends
+			return ok ({})
+
+
+def serve (server):
+	server.serve_forever ()
+
+
+def main ():
+	parser = argparse.ArgumentParser (description=__doc__.split ('\n\n')[0],
+			formatter_class=argparse.ArgumentDefaultsHelpFormatter)
+	parser.add_argument ('--host', default='127.0.0.1')
+	parser.add_argument ('--port', type=int, default=0,
+			help='plain http port, 0 picks a free one')
+	parser.add_argument ('--tls-port', type=int, default=0,
+			help='https port, 0 picks a free one')
+	parser.add_argument ('--cert', required=True,
+			help='pem file with certificate and private key')
+	parser.add_argument ('--inkey', default=DEFAULT_INKEY)
+	parser.add_argument ('--outkey', default=DEFAULT_OUTKEY)
+	parser.add_argument ('--stations', type=int, default=20)
+	parser.add_argument ('--playlist-size', type=int, default=4)
+	parser.add_argument ('--song-length', type=int, default=3,
+			help='seconds')
+	parser.add_argument ('--latency', type=float, default=0,
+			help='rpc latency in ms')
+	parser.add_argument ('--jitter', type=float, default=0,
+			help='uniformly distributed extra rpc latency in ms')
+	parser.add_argument ('--audio-latency', type=float, default=0,
+			help='audio latency in ms')
+	parser.add_argument ('--error-rate', type=float, default=0,
+			help='fraction of rpcs failing with --error-code')
+	parser.add_argument ('--error-code', type=int, default=E_INTERNAL)
+	parser.add_argument ('--seed', type=int, default=None)
+	parser.add_argument ('--log', help='append json request log here')
+	parser.add_argument ('--verbose', action='store_true')
+	args = parser.parse_args ()
+
+	state = MockState (args)
+
+	http = ThreadingHTTPServer ((args.host, args.port), Handler)
+	http.state = state
+	state.httpUrl = 'http://%s:%i' % (args.host, http.server_address[1])
+
+	https = ThreadingHTTPServer ((args.host, args.tls_port), Handler)
+	https.state = state
+	ctx = ssl.SSLContext (ssl.PROTOCOL_TLS_SERVER)
+	ctx.load_cert_chain (args.cert)
+	https.socket = ctx.wrap_socket (https.socket, server_side=True)
+
+	for s in (http, https):
+		threading.Thread (target=serve, args=(s, ), daemon=True).start ()
+
+	print ('port=%i tls_port=%i' % (http.server_address[1],
+			https.server_address[1]), flush=True)
+	try:
+		threading.Event ().wait ()
+	except KeyboardInterrupt:
+		pass
+
+
+if __name__ == '__main__':
+	main ()
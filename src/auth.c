@@ -0,0 +1,249 @@
+/*
+Copyright (c) 2020
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* persistent session: partner and user auth tokens are stored after login,
+ * so the next start can skip auth.partnerLogin and auth.userLogin. The file
+ * is only readable by its owner and encrypted with AES-256-GCM, the key is
+ * derived from the user’s password; the username is authenticated as well.
+ * Changing either invalidates the stored session.
+ *
+ * Layout: magic, salt, nonce, ciphertext, tag
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <gcrypt.h>
+
+#include "auth.h"
+#include "debug.h"
+
+#define MAGIC "PBAUTH1"
+#define MAGIC_LEN (sizeof (MAGIC) - 1)
+#define SALT_LEN 16
+#define NONCE_LEN 12
+#define TAG_LEN 16
+#define KEY_LEN 32
+#define KDF_ITERATIONS 10000
+/* tokens are way shorter than this */
+#define MAX_PLAIN 4096
+
+/*	set up cipher handle for user/password
+ */
+static bool BarAuthCipher (gcry_cipher_hd_t * const h,
+		const char * const user, const char * const password,
+		const unsigned char * const salt, const unsigned char * const nonce) {
+	unsigned char key[KEY_LEN];
+
+	if (gcry_kdf_derive (password, strlen (password), GCRY_KDF_PBKDF2,
+			GCRY_MD_SHA256, salt, SALT_LEN, KDF_ITERATIONS, sizeof (key),
+			key) != GPG_ERR_NO_ERROR) {
+		return false;
+	}
+	if (gcry_cipher_open (h, GCRY_CIPHER_AES256, GCRY_CIPHER_MODE_GCM, 0) !=
+			GPG_ERR_NO_ERROR) {
+		return false;
+	}
+	const bool ret = gcry_cipher_setkey (*h, key, sizeof (key)) ==
+				GPG_ERR_NO_ERROR &&
+			gcry_cipher_setiv (*h, nonce, NONCE_LEN) == GPG_ERR_NO_ERROR &&
+			gcry_cipher_authenticate (*h, user, strlen (user)) ==
+				GPG_ERR_NO_ERROR;
+	memset (key, 0, sizeof (key));
+	if (!ret) {
+		gcry_cipher_close (*h);
+	}
+	return ret;
+}
+
+/*	restore session from path into ph. Returns false if there is no usable
+ *	session.
+ */
+bool BarAuthLoad (PianoHandle_t * const ph, const char * const path,
+		const char * const user, const char * const password) {
+	assert (ph != NULL);
+
+	if (path == NULL || user == NULL || password == NULL) {
+		return false;
+	}
+
+	FILE * const fd = fopen (path, "rb");
+	if (fd == NULL) {
+		return false;
+	}
+
+	unsigned char buf[MAGIC_LEN + SALT_LEN + NONCE_LEN + MAX_PLAIN + TAG_LEN];
+	const size_t size = fread (buf, 1, sizeof (buf), fd);
+	fclose (fd);
+
+	const size_t overhead = MAGIC_LEN + SALT_LEN + NONCE_LEN + TAG_LEN;
+	if (size <= overhead || size == sizeof (buf) ||
+			memcmp (buf, MAGIC, MAGIC_LEN) != 0) {
+		return false;
+	}
+	const unsigned char * const salt = buf + MAGIC_LEN;
+	const unsigned char * const nonce = salt + SALT_LEN;
+	unsigned char * const crypted = (unsigned char *) nonce + NONCE_LEN;
+	const size_t cryptedLen = size - overhead;
+	const unsigned char * const tag = crypted + cryptedLen;
+
+	gcry_cipher_hd_t h;
+	if (!BarAuthCipher (&h, user, password, salt, nonce)) {
+		return false;
+	}
+	char plain[MAX_PLAIN + 1];
+	const bool ok = gcry_cipher_decrypt (h, plain, cryptedLen, crypted,
+				cryptedLen) == GPG_ERR_NO_ERROR &&
+			gcry_cipher_checktag (h, tag, TAG_LEN) == GPG_ERR_NO_ERROR;
+	gcry_cipher_close (h);
+	if (!ok) {
+		debugPrint (DEBUG_NETWORK, "auth: stored session is not ours\n");
+		return false;
+	}
+	plain[cryptedLen] = '\0';
+
+	/* key = value lines, like the state file */
+	char *partnerToken = NULL, *userId = NULL, *userToken = NULL;
+	unsigned int partnerId = 0;
+	int timeOffset = 0;
+	char *saveptr = NULL;
+	for (char *line = strtok_r (plain, "\n", &saveptr); line != NULL;
+			line = strtok_r (NULL, "\n", &saveptr)) {
+		char * const sep = strstr (line, " = ");
+		if (sep == NULL) {
+			continue;
+		}
+		*sep = '\0';
+		const char * const key = line, * const val = sep + 3;
+		if (strcmp (key, "partner_id") == 0) {
+			partnerId = strtoul (val, NULL, 10);
+		} else if (strcmp (key, "partner_auth_token") == 0) {
+			free (partnerToken);
+			partnerToken = strdup (val);
+		} else if (strcmp (key, "user_id") == 0) {
+			free (userId);
+			userId = strdup (val);
+		} else if (strcmp (key, "user_auth_token") == 0) {
+			free (userToken);
+			userToken = strdup (val);
+		} else if (strcmp (key, "time_offset") == 0) {
+			timeOffset = atoi (val);
+		}
+	}
+	memset (plain, 0, sizeof (plain));
+
+	if (partnerToken == NULL || userId == NULL || userToken == NULL) {
+		free (partnerToken);
+		free (userId);
+		free (userToken);
+		return false;
+	}
+
+	free (ph->partner.authToken);
+	ph->partner.authToken = partnerToken;
+	ph->partner.id = partnerId;
+	free (ph->user.listenerId);
+	free (ph->user.authToken);
+	ph->user.listenerId = userId;
+	ph->user.authToken = userToken;
+	ph->timeOffset = timeOffset;
+
+	return true;
+}
+
+/*	store session of ph at path
+ */
+void BarAuthSave (const PianoHandle_t * const ph, const char * const path,
+		const char * const user, const char * const password) {
+	assert (ph != NULL);
+
+	if (path == NULL || user == NULL || password == NULL ||
+			ph->partner.authToken == NULL || ph->user.listenerId == NULL ||
+			ph->user.authToken == NULL) {
+		return;
+	}
+
+	char plain[MAX_PLAIN];
+	const int plainLen = snprintf (plain, sizeof (plain),
+			"partner_id = %u\n"
+			"partner_auth_token = %s\n"
+			"user_id = %s\n"
+			"user_auth_token = %s\n"
+			"time_offset = %i\n",
+			ph->partner.id, ph->partner.authToken, ph->user.listenerId,
+			ph->user.authToken, ph->timeOffset);
+	if (plainLen < 0 || (size_t) plainLen >= sizeof (plain)) {
+		return;
+	}
+
+	unsigned char buf[MAGIC_LEN + SALT_LEN + NONCE_LEN + MAX_PLAIN + TAG_LEN];
+	unsigned char * const salt = buf + MAGIC_LEN;
+	unsigned char * const nonce = salt + SALT_LEN;
+	unsigned char * const crypted = nonce + NONCE_LEN;
+	unsigned char * const tag = crypted + plainLen;
+	memcpy (buf, MAGIC, MAGIC_LEN);
+	gcry_randomize (salt, SALT_LEN, GCRY_STRONG_RANDOM);
+	gcry_create_nonce (nonce, NONCE_LEN);
+
+	gcry_cipher_hd_t h;
+	if (!BarAuthCipher (&h, user, password, salt, nonce)) {
+		return;
+	}
+	const bool ok = gcry_cipher_encrypt (h, crypted, plainLen, plain,
+				plainLen) == GPG_ERR_NO_ERROR &&
+			gcry_cipher_gettag (h, tag, TAG_LEN) == GPG_ERR_NO_ERROR;
+	gcry_cipher_close (h);
+	memset (plain, 0, sizeof (plain));
+	if (!ok) {
+		return;
+	}
+
+	/* never readable by anyone else, not even briefly */
+	const int fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd == -1) {
+		return;
+	}
+	fchmod (fd, 0600);
+	const size_t size = tag + TAG_LEN - buf;
+	if (write (fd, buf, size) != (ssize_t) size) {
+		close (fd);
+		unlink (path);
+		return;
+	}
+	close (fd);
+}
+
+/*	remove stored session
+ */
+void BarAuthForget (const char * const path) {
+	if (path != NULL) {
+		unlink (path);
+	}
+}
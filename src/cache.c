@@ -0,0 +1,213 @@
+/*
+Copyright (c) 2020
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* persistent cache for responses that rarely change (station list, genre
+ * stations, station info). Each entry is a single file containing a header
+ * line with the time it was stored and the user it belongs to, followed by
+ * the response body as received from pandora. */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "cache.h"
+#include "debug.h"
+
+/*	create dir and its parents
+ */
+static void BarCacheMkdir (const char * const dir) {
+	char * const path = strdup (dir);
+	assert (path != NULL);
+
+	/* EEXIST is fine, everything else is caught by open later */
+	for (char *p = strchr (path + 1, '/'); p != NULL; p = strchr (p + 1, '/')) {
+		*p = '\0';
+		mkdir (path, 0700);
+		*p = '/';
+	}
+	mkdir (path, 0700);
+	free (path);
+}
+
+/*	initialize cache in directory dir for user, discarding entries older
+ *	than maxAge seconds
+ */
+void BarCacheInit (BarCache_t * const cache, const char * const dir,
+		const char * const user, const time_t maxAge) {
+	assert (cache != NULL);
+
+	memset (cache, 0, sizeof (*cache));
+	if (dir == NULL || user == NULL) {
+		return;
+	}
+
+	BarCacheMkdir (dir);
+
+	cache->dir = strdup (dir);
+	cache->user = strdup (user);
+	cache->maxAge = maxAge;
+}
+
+void BarCacheDestroy (BarCache_t * const cache) {
+	free (cache->dir);
+	free (cache->user);
+	memset (cache, 0, sizeof (*cache));
+}
+
+static char *BarCachePath (const BarCache_t * const cache,
+		const char * const key, const char * const suffix) {
+	const size_t len = strlen (cache->dir) + 1 + strlen (key) +
+			strlen (suffix) + 1;
+	char * const path = malloc (len);
+	assert (path != NULL);
+	snprintf (path, len, "%s/%s%s", cache->dir, key, suffix);
+	return path;
+}
+
+/*	get entry key, which is stale if it is older than ttl seconds. Returns
+ *	malloc’ed response or NULL. Entries older than the cache’s maximum age
+ *	are removed.
+ */
+char *BarCacheGet (BarCache_t * const cache, const char * const key,
+		const time_t ttl, bool * const stale) {
+	assert (key != NULL);
+	assert (stale != NULL);
+
+	if (cache->dir == NULL) {
+		return NULL;
+	}
+
+	char * const path = BarCachePath (cache, key, "");
+	FILE * const fd = fopen (path, "r");
+	if (fd == NULL) {
+		free (path);
+		++cache->misses;
+		return NULL;
+	}
+
+	char *body = NULL;
+	long long int stored;
+	char user[256];
+	if (fscanf (fd, "# %lld %255s", &stored, user) != 2 ||
+			strcmp (user, cache->user) != 0 || fgetc (fd) != '\n') {
+		goto cleanup;
+	}
+
+	const time_t age = time (NULL) - (time_t) stored;
+	if (cache->maxAge > 0 && age >= cache->maxAge) {
+		/* too old to be worth showing, even while refreshing */
+		debugPrint (DEBUG_NETWORK, "cache entry %s expired, age %lld\n", key,
+				(long long int) age);
+		unlink (path);
+		goto cleanup;
+	}
+
+	const long start = ftell (fd);
+	if (fseek (fd, 0, SEEK_END) != 0) {
+		goto cleanup;
+	}
+	const long end = ftell (fd);
+	if (start < 0 || end <= start || fseek (fd, start, SEEK_SET) != 0) {
+		goto cleanup;
+	}
+
+	const size_t size = end - start;
+	body = malloc (size + 1);
+	assert (body != NULL);
+	if (fread (body, 1, size, fd) != size) {
+		free (body);
+		body = NULL;
+		goto cleanup;
+	}
+	body[size] = '\0';
+
+	*stale = age < 0 || age >= ttl;
+	debugPrint (DEBUG_NETWORK, "cache hit %s, age %lld%s\n", key,
+			(long long int) age, *stale ? " (stale)" : "");
+
+cleanup:
+	fclose (fd);
+	free (path);
+	if (body == NULL) {
+		++cache->misses;
+	} else {
+		++cache->hits;
+	}
+	return body;
+}
+
+/*	store response body under key, replacing the previous entry atomically
+ */
+void BarCachePut (BarCache_t * const cache, const char * const key,
+		const char * const body) {
+	assert (key != NULL);
+	assert (body != NULL);
+
+	if (cache->dir == NULL) {
+		return;
+	}
+
+	char * const tmpPath = BarCachePath (cache, key, ".tmp");
+	char * const path = BarCachePath (cache, key, "");
+	/* contains station tokens */
+	const int fdno = open (tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fdno == -1) {
+		goto cleanup;
+	}
+	FILE * const fd = fdopen (fdno, "w");
+	if (fd == NULL) {
+		close (fdno);
+		unlink (tmpPath);
+		goto cleanup;
+	}
+	fprintf (fd, "# %lld %s\n", (long long int) time (NULL), cache->user);
+	fputs (body, fd);
+	if (fclose (fd) != 0 || rename (tmpPath, path) != 0) {
+		unlink (tmpPath);
+	}
+
+cleanup:
+	free (tmpPath);
+	free (path);
+}
+
+/*	invalidate entry key
+ */
+void BarCacheDrop (BarCache_t * const cache, const char * const key) {
+	assert (key != NULL);
+
+	if (cache->dir == NULL) {
+		return;
+	}
+
+	char * const path = BarCachePath (cache, key, "");
+	unlink (path);
+	free (path);
+}
@@ -0,0 +1,49 @@
+/*
+Copyright (c) 2020
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <time.h>
+
+/* on-disk cache of raw api responses */
+typedef struct {
+	/* cache directory, NULL if disabled */
+	char *dir;
+	/* owner of cached data */
+	char *user;
+	/* entries older than this are discarded, seconds */
+	time_t maxAge;
+	unsigned long hits, misses;
+} BarCache_t;
+
+void BarCacheInit (BarCache_t * const, const char * const,
+		const char * const, const time_t);
+void BarCacheDestroy (BarCache_t * const);
+char *BarCacheGet (BarCache_t * const, const char * const, const time_t,
+		bool * const);
+void BarCachePut (BarCache_t * const, const char * const,
+		const char * const);
+void BarCacheDrop (BarCache_t * const, const char * const);
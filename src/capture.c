@@ -0,0 +1,230 @@
+/*
+Copyright (c) 2020
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* record and replay rpc exchanges, for deterministic regression runs against
+ * production-shaped data. Capture file format, per exchange a header line
+ *
+ *   rpc <type> <curl code> <duration ms> <path len> <request len> <response len>
+ *
+ * followed by the url path, the unencrypted request body, the response body
+ * and a newline. Login request bodies contain the password and are not
+ * recorded. */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "capture.h"
+#include "debug.h"
+
+/* sanity limit for a single body */
+#define MAX_BODY (64*1024*1024)
+
+static char *BarCaptureReadBlob (FILE * const fd, const size_t len) {
+	if (len > MAX_BODY) {
+		return NULL;
+	}
+	char * const buf = malloc (len + 1);
+	if (buf == NULL) {
+		return NULL;
+	}
+	if (fread (buf, 1, len, fd) != len) {
+		free (buf);
+		return NULL;
+	}
+	buf[len] = '\0';
+	return buf;
+}
+
+static void BarCaptureFreeEntry (BarCaptureEntry_t * const e) {
+	free (e->path);
+	free (e->request);
+	free (e->response);
+	free (e);
+}
+
+/*	read all exchanges from capture file
+ */
+static void BarCaptureLoad (BarCapture_t * const cap, FILE * const fd) {
+	BarCaptureEntry_t **tail = &cap->entries;
+	unsigned int type;
+	int ret;
+	long duration;
+	size_t pathLen, requestLen, responseLen;
+
+	while (fscanf (fd, "rpc %u %d %ld %zu %zu %zu", &type, &ret, &duration,
+			&pathLen, &requestLen, &responseLen) == 6) {
+		if (fgetc (fd) != '\n') {
+			break;
+		}
+		BarCaptureEntry_t * const e = calloc (1, sizeof (*e));
+		if (e == NULL) {
+			break;
+		}
+		e->type = type;
+		e->ret = ret;
+		e->duration = duration;
+		e->responseLen = responseLen;
+		if ((e->path = BarCaptureReadBlob (fd, pathLen)) == NULL ||
+				(e->request = BarCaptureReadBlob (fd, requestLen)) == NULL ||
+				(e->response = BarCaptureReadBlob (fd, responseLen)) == NULL ||
+				fgetc (fd) != '\n') {
+			/* truncated file */
+			BarCaptureFreeEntry (e);
+			break;
+		}
+		*tail = e;
+		tail = &e->next;
+	}
+}
+
+/*	start recording to or replaying from capture files, either may be NULL
+ *	@return false if the file could not be opened, errno is set
+ */
+bool BarCaptureInit (BarCapture_t * const cap, const char * const record,
+		const char * const replay, const bool realtime) {
+	memset (cap, 0, sizeof (*cap));
+	cap->realtime = realtime;
+
+	if (replay != NULL) {
+		FILE * const fd = fopen (replay, "r");
+		if (fd == NULL) {
+			return false;
+		}
+		BarCaptureLoad (cap, fd);
+		fclose (fd);
+		/* never fall back to the network */
+		cap->replay = true;
+	} else if (record != NULL) {
+		/* contains auth tokens */
+		const int fd = open (record, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+		if (fd == -1) {
+			return false;
+		}
+		if ((cap->record = fdopen (fd, "w")) == NULL) {
+			const int err = errno;
+			close (fd);
+			errno = err;
+			return false;
+		}
+	}
+	return true;
+}
+
+void BarCaptureDestroy (BarCapture_t * const cap) {
+	if (cap->record != NULL) {
+		fclose (cap->record);
+	}
+	BarCaptureEntry_t *e = cap->entries;
+	while (e != NULL) {
+		BarCaptureEntry_t * const next = e->next;
+		BarCaptureFreeEntry (e);
+		e = next;
+	}
+	debugPrint (DEBUG_NETWORK, "capture: %lu recorded, %lu replayed, "
+			"%lu missed\n", cap->recorded, cap->replayed, cap->missed);
+	memset (cap, 0, sizeof (*cap));
+}
+
+/*	append exchange to capture file
+ *	@param capture
+ *	@param request, with plain text body
+ *	@param transfer result
+ *	@param duration in ms
+ *	@param response body, may be NULL
+ *	@param response length
+ */
+void BarCaptureRecord (BarCapture_t * const cap,
+		const PianoRequest_t * const req, const CURLcode ret,
+		const long duration, const char * const response,
+		const size_t responseLen) {
+	if (cap->record == NULL) {
+		return;
+	}
+
+	const char *request = req->plainData;
+	if (request == NULL || req->type == PIANO_REQUEST_LOGIN) {
+		request = "";
+	}
+	if (response == NULL) {
+		assert (responseLen == 0);
+	}
+	const size_t pathLen = strlen (req->urlPath),
+			requestLen = strlen (request);
+	fprintf (cap->record, "rpc %u %d %ld %zu %zu %zu\n", req->type, ret,
+			duration, pathLen, requestLen, responseLen);
+	fwrite (req->urlPath, 1, pathLen, cap->record);
+	fwrite (request, 1, requestLen, cap->record);
+	if (responseLen > 0) {
+		fwrite (response, 1, responseLen, cap->record);
+	}
+	fputc ('\n', cap->record);
+	fflush (cap->record);
+	++cap->recorded;
+}
+
+/*	length of the method=… parameter in a url path
+ */
+static size_t BarCaptureMethod (const char * const path,
+		const char ** const method) {
+	*method = strstr (path, "method=");
+	if (*method == NULL) {
+		return 0;
+	}
+	return strcspn (*method, "&");
+}
+
+/*	find oldest unused exchange for req. Asynchronous requests may finish
+ *	in a different order, so type and method are matched instead of relying
+ *	on sequence alone.
+ *	@return exchange or NULL if the capture has none left
+ */
+const BarCaptureEntry_t *BarCaptureNext (BarCapture_t * const cap,
+		const PianoRequest_t * const req) {
+	const char *method;
+	const size_t methodLen = BarCaptureMethod (req->urlPath, &method);
+
+	for (BarCaptureEntry_t *e = cap->entries; e != NULL; e = e->next) {
+		if (e->used || e->type != req->type) {
+			continue;
+		}
+		const char *entryMethod;
+		const size_t entryMethodLen = BarCaptureMethod (e->path,
+				&entryMethod);
+		if (entryMethodLen != methodLen || (methodLen > 0 &&
+				memcmp (entryMethod, method, methodLen) != 0)) {
+			continue;
+		}
+		e->used = true;
+		++cap->replayed;
+		return e;
+	}
+	++cap->missed;
+	return NULL;
+}
@@ -0,0 +1,62 @@
+/*
+Copyright (c) 2020
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <curl/curl.h>
+
+#include <piano.h>
+
+/* a recorded rpc exchange */
+typedef struct BarCaptureEntry {
+	struct BarCaptureEntry *next;
+	PianoRequestType_t type;
+	CURLcode ret;
+	/* duration of the original exchange, ms */
+	long duration;
+	char *path, *request, *response;
+	size_t responseLen;
+	bool used;
+} BarCaptureEntry_t;
+
+typedef struct {
+	/* capture file being written, NULL if not recording */
+	FILE *record;
+	/* exchanges served instead of the network, in recorded order */
+	BarCaptureEntry_t *entries;
+	bool replay, realtime;
+	/* statistics */
+	unsigned long recorded, replayed, missed;
+} BarCapture_t;
+
+bool BarCaptureInit (BarCapture_t * const, const char * const,
+		const char * const, const bool);
+void BarCaptureDestroy (BarCapture_t * const);
+void BarCaptureRecord (BarCapture_t * const, const PianoRequest_t * const,
+		const CURLcode, const long, const char * const, const size_t);
+const BarCaptureEntry_t *BarCaptureNext (BarCapture_t * const,
+		const PianoRequest_t * const);
@@ -0,0 +1,263 @@
+/*
+Copyright (c) 2020
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* write-ahead queue for feedback (ratings, tired, bookmarks). Operations are
+ * journaled before they are applied locally and acknowledged once pandora
+ * accepted them, so nothing is lost if the network is down or pianobar
+ * quits. Journal format, one record per line:
+ *
+ *   op <id> <type> <queued> <stationId> <trackToken>
+ *   ack <id>
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "feedback.h"
+#include "debug.h"
+
+static const char *typeNames[BAR_FB_COUNT] = {"love", "ban", "tired",
+		"bookmarksong", "bookmarkartist"};
+
+const char *BarFeedbackTypeToStr (const BarFeedbackType_t type) {
+	assert (type < BAR_FB_COUNT);
+	return typeNames[type];
+}
+
+static void BarFeedbackFreeOp (BarFeedbackOp_t * const op) {
+	free (op->stationId);
+	free (op->trackToken);
+	free (op);
+}
+
+static void BarFeedbackAppend (BarFeedbackQueue_t * const q,
+		BarFeedbackOp_t * const op) {
+	op->next = NULL;
+	if (q->tail == NULL) {
+		q->head = q->tail = op;
+	} else {
+		q->tail->next = op;
+		q->tail = op;
+	}
+	++q->depth;
+}
+
+/*	make sure record hit the disk
+ */
+static void BarFeedbackSync (BarFeedbackQueue_t * const q) {
+	fflush (q->journal);
+	fsync (fileno (q->journal));
+}
+
+static void BarFeedbackWriteOp (BarFeedbackQueue_t * const q,
+		const BarFeedbackOp_t * const op) {
+	fprintf (q->journal, "op %" PRIu64 " %s %lld %s %s\n", op->id,
+			typeNames[op->type], (long long int) op->queued, op->stationId,
+			op->trackToken);
+}
+
+/*	replay journal
+ */
+static void BarFeedbackLoad (BarFeedbackQueue_t * const q, FILE * const fd) {
+	char line[1024];
+
+	while (fgets (line, sizeof (line), fd) != NULL) {
+		char *saveptr = NULL;
+		const char * const record = strtok_r (line, " \n", &saveptr);
+		const char * const idStr = strtok_r (NULL, " \n", &saveptr);
+		if (record == NULL || idStr == NULL) {
+			continue;
+		}
+		const uint64_t id = strtoull (idStr, NULL, 10);
+		if (id >= q->nextId) {
+			q->nextId = id + 1;
+		}
+
+		if (strcmp (record, "op") == 0) {
+			const char * const type = strtok_r (NULL, " \n", &saveptr);
+			const char * const queued = strtok_r (NULL, " \n", &saveptr);
+			const char * const stationId = strtok_r (NULL, " \n", &saveptr);
+			const char * const trackToken = strtok_r (NULL, " \n", &saveptr);
+			if (type == NULL || queued == NULL || stationId == NULL ||
+					trackToken == NULL) {
+				/* torn write */
+				continue;
+			}
+			BarFeedbackType_t t;
+			for (t = 0; t < BAR_FB_COUNT; t++) {
+				if (strcmp (typeNames[t], type) == 0) {
+					break;
+				}
+			}
+			if (t == BAR_FB_COUNT) {
+				continue;
+			}
+
+			BarFeedbackOp_t * const op = calloc (1, sizeof (*op));
+			assert (op != NULL);
+			op->id = id;
+			op->type = t;
+			op->queued = strtoll (queued, NULL, 10);
+			op->stationId = strdup (stationId);
+			op->trackToken = strdup (trackToken);
+			BarFeedbackAppend (q, op);
+		} else if (strcmp (record, "ack") == 0) {
+			/* acks are written in order, but be careful anyway */
+			BarFeedbackOp_t *prev = NULL, *op = q->head;
+			while (op != NULL && op->id != id) {
+				prev = op;
+				op = op->next;
+			}
+			if (op == NULL) {
+				continue;
+			}
+			if (prev == NULL) {
+				q->head = op->next;
+			} else {
+				prev->next = op->next;
+			}
+			if (q->tail == op) {
+				q->tail = prev;
+			}
+			--q->depth;
+			BarFeedbackFreeOp (op);
+		}
+	}
+}
+
+/*	rewrite journal with pending operations only
+ */
+static void BarFeedbackCompact (BarFeedbackQueue_t * const q) {
+	if (q->journal != NULL) {
+		fclose (q->journal);
+	}
+	if ((q->journal = fopen (q->path, "w")) == NULL) {
+		return;
+	}
+	for (const BarFeedbackOp_t *op = q->head; op != NULL; op = op->next) {
+		BarFeedbackWriteOp (q, op);
+	}
+	BarFeedbackSync (q);
+}
+
+/*	open journal at path and load pending operations
+ */
+void BarFeedbackInit (BarFeedbackQueue_t * const q, const char * const path) {
+	memset (q, 0, sizeof (*q));
+	q->nextId = 1;
+	if (path == NULL) {
+		return;
+	}
+	q->path = strdup (path);
+
+	FILE * const fd = fopen (path, "r");
+	if (fd != NULL) {
+		BarFeedbackLoad (q, fd);
+		fclose (fd);
+	}
+	debugPrint (DEBUG_NETWORK, "feedback queue: %zu pending operations\n",
+			q->depth);
+
+	BarFeedbackCompact (q);
+}
+
+void BarFeedbackDestroy (BarFeedbackQueue_t * const q) {
+	BarFeedbackOp_t *op = q->head;
+	while (op != NULL) {
+		BarFeedbackOp_t * const next = op->next;
+		BarFeedbackFreeOp (op);
+		op = next;
+	}
+	if (q->journal != NULL) {
+		fclose (q->journal);
+	}
+	free (q->path);
+	memset (q, 0, sizeof (*q));
+}
+
+/*	queue operation. Returns false if the same operation is pending already.
+ */
+bool BarFeedbackPush (BarFeedbackQueue_t * const q,
+		const BarFeedbackType_t type, const char * const stationId,
+		const char * const trackToken) {
+	assert (type < BAR_FB_COUNT);
+	assert (stationId != NULL);
+	assert (trackToken != NULL);
+
+	/* an operation that is in flight may still fail, so do not dedup
+	 * against the head in that case */
+	for (const BarFeedbackOp_t *op = q->inFlight ? q->head->next : q->head;
+			op != NULL; op = op->next) {
+		if (op->type == type && strcmp (op->trackToken, trackToken) == 0) {
+			return false;
+		}
+	}
+
+	BarFeedbackOp_t * const op = calloc (1, sizeof (*op));
+	assert (op != NULL);
+	op->id = q->nextId++;
+	op->type = type;
+	op->queued = time (NULL);
+	op->stationId = strdup (stationId);
+	op->trackToken = strdup (trackToken);
+	BarFeedbackAppend (q, op);
+
+	if (q->journal != NULL) {
+		BarFeedbackWriteOp (q, op);
+		BarFeedbackSync (q);
+	}
+
+	return true;
+}
+
+/*	remove head, it has been sent (or failed permanently)
+ */
+void BarFeedbackPop (BarFeedbackQueue_t * const q) {
+	BarFeedbackOp_t * const op = q->head;
+	assert (op != NULL);
+
+	q->head = op->next;
+	if (q->head == NULL) {
+		q->tail = NULL;
+	}
+	--q->depth;
+	q->attempts = 0;
+	q->retryAfter = 0;
+
+	if (q->journal != NULL) {
+		if (q->head == NULL) {
+			/* nothing left, start over with an empty journal */
+			BarFeedbackCompact (q);
+		} else {
+			fprintf (q->journal, "ack %" PRIu64 "\n", op->id);
+			BarFeedbackSync (q);
+		}
+	}
+
+	BarFeedbackFreeOp (op);
+}
@@ -0,0 +1,76 @@
+/*
+Copyright (c) 2020
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+typedef enum {
+	BAR_FB_LOVE = 0,
+	BAR_FB_BAN = 1,
+	BAR_FB_TIRED = 2,
+	BAR_FB_BOOKMARK_SONG = 3,
+	BAR_FB_BOOKMARK_ARTIST = 4,
+	BAR_FB_COUNT = 5,
+} BarFeedbackType_t;
+
+/* a single queued feedback operation */
+typedef struct BarFeedbackOp {
+	struct BarFeedbackOp *next;
+	uint64_t id;
+	BarFeedbackType_t type;
+	char *stationId, *trackToken;
+	/* time it was queued */
+	time_t queued;
+} BarFeedbackOp_t;
+
+/* durable, in-order queue of feedback operations */
+typedef struct {
+	/* append-only journal */
+	FILE *journal;
+	char *path;
+	BarFeedbackOp_t *head, *tail;
+	uint64_t nextId;
+	/* an operation is sent to pandora right now */
+	bool inFlight;
+	/* attempts of the queue’s head the rpc layer gave up on and time of
+	 * the next one */
+	unsigned int attempts;
+	time_t retryAfter;
+	/* statistics */
+	size_t depth;
+	unsigned long flushed, failed;
+	double lastLatency, totalLatency;
+} BarFeedbackQueue_t;
+
+void BarFeedbackInit (BarFeedbackQueue_t * const, const char * const);
+void BarFeedbackDestroy (BarFeedbackQueue_t * const);
+bool BarFeedbackPush (BarFeedbackQueue_t * const, const BarFeedbackType_t,
+		const char * const, const char * const);
+void BarFeedbackPop (BarFeedbackQueue_t * const);
+const char *BarFeedbackTypeToStr (const BarFeedbackType_t);
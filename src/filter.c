@@ -0,0 +1,365 @@
+/*
+Copyright (c) 2020
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+
+#include "filter.h"
+
+/* at most this many approximate matches are returned */
+#define BAR_FILTER_FUZZY_MAX 10
+
+void BarFilterInit (BarFilter_t * const f) {
+	assert (f != NULL);
+
+	memset (f, 0, sizeof (*f));
+}
+
+/*	drop the index and query buffers, they are recreated when needed
+ */
+static void BarFilterDropIndex (BarFilter_t * const f) {
+	free (f->keys);
+	free (f->postings);
+	free (f->offsets);
+	free (f->score);
+	free (f->touched);
+	free (f->matches);
+	f->keys = f->postings = NULL;
+	f->offsets = f->touched = f->matches = NULL;
+	f->score = NULL;
+	f->keyCount = 0;
+	f->built = false;
+}
+
+void BarFilterDestroy (BarFilter_t * const f) {
+	assert (f != NULL);
+
+	BarFilterDropIndex (f);
+	for (size_t i = 0; i < f->count; i++) {
+		free (f->text[i]);
+	}
+	free (f->text);
+	BarFilterInit (f);
+}
+
+/*	lowercase copy of s, appended to dest
+ */
+static char *BarFilterLower (char *dest, const char *s) {
+	while (*s != '\0') {
+		*dest++ = tolower ((unsigned char) *s++);
+	}
+	return dest;
+}
+
+/*	add entry consisting of nfields strings, NULL fields are skipped
+ *	@return false if out of memory, the entry never matches in that case
+ */
+bool BarFilterAdd (BarFilter_t * const f, const char * const * const fields,
+		const size_t nfields) {
+	assert (f != NULL);
+	assert (fields != NULL);
+
+	BarFilterDropIndex (f);
+
+	if (f->count == f->capacity) {
+		const size_t capacity = f->capacity == 0 ? 64 : f->capacity * 2;
+		char ** const text = realloc (f->text, capacity * sizeof (*text));
+		if (text == NULL) {
+			return false;
+		}
+		f->text = text;
+		f->capacity = capacity;
+	}
+
+	size_t len = 0;
+	for (size_t i = 0; i < nfields; i++) {
+		if (fields[i] != NULL) {
+			len += strlen (fields[i]) + 1;
+		}
+	}
+	char * const text = malloc (len + 1);
+	if (text != NULL) {
+		char *pos = text;
+		for (size_t i = 0; i < nfields; i++) {
+			if (fields[i] != NULL) {
+				pos = BarFilterLower (pos, fields[i]);
+				/* keep trigrams and matches within one field */
+				*pos++ = '\n';
+			}
+		}
+		*pos = '\0';
+	}
+	f->text[f->count++] = text;
+
+	return text != NULL;
+}
+
+static uint32_t BarFilterTrigram (const char * const s) {
+	return (uint32_t) (unsigned char) s[0] << 16 |
+			(uint32_t) (unsigned char) s[1] << 8 |
+			(uint32_t) (unsigned char) s[2];
+}
+
+static int BarFilterCmpU64 (const void *a, const void *b) {
+	const uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+	return (x > y) - (x < y);
+}
+
+static int BarFilterCmpU32 (const void *a, const void *b) {
+	const uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+	return (x > y) - (x < y);
+}
+
+static int BarFilterCmpSize (const void *a, const void *b) {
+	const size_t x = *(const size_t *) a, y = *(const size_t *) b;
+	return (x > y) - (x < y);
+}
+
+/*	allocate per query scratch space
+ */
+static bool BarFilterAlloc (BarFilter_t * const f) {
+	const size_t n = f->count == 0 ? 1 : f->count;
+
+	f->score = calloc (n, sizeof (*f->score));
+	f->touched = malloc (n * sizeof (*f->touched));
+	f->matches = malloc (n * sizeof (*f->matches));
+	if (f->score == NULL || f->touched == NULL || f->matches == NULL) {
+		BarFilterDropIndex (f);
+		return false;
+	}
+	return true;
+}
+
+/*	build trigram index. It may be missing if memory is short, queries scan
+ *	all entries then.
+ */
+static void BarFilterBuild (BarFilter_t * const f) {
+	f->built = true;
+
+	/* collect (trigram, entry) pairs, sorting them groups entries by
+	 * trigram */
+	size_t pairCount = 0;
+	for (size_t i = 0; i < f->count; i++) {
+		if (f->text[i] != NULL) {
+			pairCount += strlen (f->text[i]);
+		}
+	}
+	uint64_t * const pairs = malloc ((pairCount + 1) * sizeof (*pairs));
+	if (pairs == NULL) {
+		return;
+	}
+	pairCount = 0;
+	for (size_t i = 0; i < f->count; i++) {
+		const char *s = f->text[i];
+		if (s == NULL) {
+			continue;
+		}
+		for (; s[0] != '\0' && s[1] != '\0' && s[2] != '\0'; s++) {
+			if (s[0] != '\n' && s[1] != '\n' && s[2] != '\n') {
+				pairs[pairCount++] = (uint64_t) BarFilterTrigram (s) << 32 | i;
+			}
+		}
+	}
+	qsort (pairs, pairCount, sizeof (*pairs), BarFilterCmpU64);
+
+	size_t keyCount = 0, postingCount = 0;
+	for (size_t i = 0; i < pairCount; i++) {
+		if (i == 0 || pairs[i] != pairs[i-1]) {
+			pairs[postingCount++] = pairs[i];
+			if (postingCount == 1 ||
+					pairs[postingCount-1] >> 32 != pairs[postingCount-2] >> 32) {
+				++keyCount;
+			}
+		}
+	}
+
+	f->keys = malloc ((keyCount + 1) * sizeof (*f->keys));
+	f->offsets = malloc ((keyCount + 1) * sizeof (*f->offsets));
+	f->postings = malloc ((postingCount + 1) * sizeof (*f->postings));
+	if (f->keys == NULL || f->offsets == NULL || f->postings == NULL) {
+		free (f->keys);
+		free (f->offsets);
+		free (f->postings);
+		f->keys = f->postings = NULL;
+		f->offsets = NULL;
+		free (pairs);
+		return;
+	}
+
+	size_t k = 0;
+	for (size_t i = 0; i < postingCount; i++) {
+		const uint32_t trigram = pairs[i] >> 32;
+		if (i == 0 || trigram != f->keys[k-1]) {
+			f->keys[k] = trigram;
+			f->offsets[k] = i;
+			++k;
+		}
+		f->postings[i] = (uint32_t) pairs[i];
+	}
+	assert (k == keyCount);
+	f->offsets[keyCount] = postingCount;
+	f->keyCount = keyCount;
+	free (pairs);
+}
+
+/*	find entries containing query
+ *	@param filter
+ *	@param lowercase query
+ *	@return number of matches, written to f->matches in entry order
+ */
+static size_t BarFilterScan (BarFilter_t * const f, const char * const query) {
+	size_t n = 0;
+
+	for (size_t i = 0; i < f->count; i++) {
+		if (f->text[i] != NULL && strstr (f->text[i], query) != NULL) {
+			f->matches[n++] = i;
+		}
+	}
+
+	return n;
+}
+
+/*	find entries containing query (exact), or sharing at least a third of its
+ *	trigrams (fuzzy) if there is no exact match. Fuzzy matches are ranked by
+ *	the number of trigrams shared.
+ *	@param filter
+ *	@param query, matched case-insensitively. An empty query matches all
+ *		entries.
+ *	@param returns number of matches
+ *	@param returns true if the matches are fuzzy
+ *	@return entry ids, valid until the next call. NULL if out of memory.
+ */
+const size_t *BarFilterMatch (BarFilter_t * const f, const char * const query,
+		size_t * const retCount, bool * const retFuzzy) {
+	assert (f != NULL);
+	assert (query != NULL);
+	assert (retCount != NULL);
+	assert (retFuzzy != NULL);
+
+	*retCount = 0;
+	*retFuzzy = false;
+
+	if (f->matches == NULL && !BarFilterAlloc (f)) {
+		return NULL;
+	}
+
+	const size_t queryLen = strlen (query);
+	if (queryLen == 0) {
+		for (size_t i = 0; i < f->count; i++) {
+			f->matches[i] = i;
+		}
+		*retCount = f->count;
+		return f->matches;
+	}
+
+	char * const lower = malloc (queryLen + 1);
+	uint32_t * const trigrams = malloc (queryLen * sizeof (*trigrams));
+	if (lower == NULL || trigrams == NULL) {
+		free (lower);
+		free (trigrams);
+		return NULL;
+	}
+	*BarFilterLower (lower, query) = '\0';
+
+	/* short queries do not need the index */
+	if (queryLen >= 3 && !f->built) {
+		BarFilterBuild (f);
+	}
+	if (queryLen < 3 || f->keys == NULL) {
+		*retCount = BarFilterScan (f, lower);
+		free (lower);
+		free (trigrams);
+		return f->matches;
+	}
+
+	/* distinct query trigrams */
+	size_t trigramCount = 0;
+	for (size_t i = 0; i + 2 < queryLen; i++) {
+		trigrams[trigramCount++] = BarFilterTrigram (&lower[i]);
+	}
+	qsort (trigrams, trigramCount, sizeof (*trigrams), BarFilterCmpU32);
+	size_t distinct = 0;
+	for (size_t i = 0; i < trigramCount; i++) {
+		if (i == 0 || trigrams[i] != trigrams[distinct-1]) {
+			trigrams[distinct++] = trigrams[i];
+		}
+	}
+	trigramCount = distinct;
+
+	/* count trigrams per entry, only visiting the postings of query
+	 * trigrams */
+	size_t touchedCount = 0;
+	for (size_t i = 0; i < trigramCount; i++) {
+		const uint32_t * const key = bsearch (&trigrams[i], f->keys,
+				f->keyCount, sizeof (*f->keys), BarFilterCmpU32);
+		if (key == NULL) {
+			continue;
+		}
+		const size_t k = key - f->keys;
+		for (size_t j = f->offsets[k]; j < f->offsets[k+1]; j++) {
+			const uint32_t id = f->postings[j];
+			if (f->score[id]++ == 0) {
+				f->touched[touchedCount++] = id;
+			}
+		}
+	}
+	qsort (f->touched, touchedCount, sizeof (*f->touched), BarFilterCmpSize);
+
+	/* candidates containing all trigrams may still not contain the query */
+	size_t n = 0;
+	for (size_t i = 0; i < touchedCount; i++) {
+		const size_t id = f->touched[i];
+		if (f->score[id] == trigramCount &&
+				strstr (f->text[id], lower) != NULL) {
+			f->matches[n++] = id;
+		}
+	}
+
+	if (n == 0) {
+		for (size_t s = trigramCount; s > 0 && s * 3 >= trigramCount &&
+				n < BAR_FILTER_FUZZY_MAX; s--) {
+			for (size_t i = 0; i < touchedCount &&
+					n < BAR_FILTER_FUZZY_MAX; i++) {
+				const size_t id = f->touched[i];
+				if (f->score[id] == s) {
+					f->matches[n++] = id;
+				}
+			}
+		}
+		*retFuzzy = n > 0;
+	}
+
+	for (size_t i = 0; i < touchedCount; i++) {
+		f->score[f->touched[i]] = 0;
+	}
+
+	free (lower);
+	free (trigrams);
+
+	*retCount = n;
+	return f->matches;
+}
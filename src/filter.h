@@ -0,0 +1,56 @@
+/*
+Copyright (c) 2020
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Case-insensitive substring filter over a fixed list of entries, used by
+ * the selection prompts. Entries are identified by the order they were added
+ * in. A trigram index is built on the first query of three or more
+ * characters; shorter queries scan all entries. The filter is a snapshot: if
+ * the underlying list changes it must be destroyed and rebuilt. */
+typedef struct {
+	/* lowercase copy of each entry, fields separated by \n */
+	char **text;
+	size_t count, capacity;
+	/* sorted distinct trigrams. Entries containing keys[k] are
+	 * postings[offsets[k]] to postings[offsets[k+1]-1], ascending. */
+	uint32_t *keys, *postings;
+	size_t *offsets, keyCount;
+	bool built;
+	/* per query scratch space, one slot per entry */
+	unsigned int *score;
+	size_t *touched, *matches;
+} BarFilter_t;
+
+void BarFilterInit (BarFilter_t * const);
+void BarFilterDestroy (BarFilter_t * const);
+bool BarFilterAdd (BarFilter_t * const, const char * const * const,
+		const size_t);
+const size_t *BarFilterMatch (BarFilter_t * const, const char * const,
+		size_t * const, bool * const);
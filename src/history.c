@@ -0,0 +1,94 @@
+/*
+Copyright (c) 2020
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "history.h"
+
+/*	initialize history for up to capacity songs, 0 disables it
+ */
+void BarHistoryInit (BarHistory_t * const h, const size_t capacity) {
+	assert (h != NULL);
+
+	h->songs = NULL;
+	h->capacity = capacity;
+	h->count = 0;
+	h->newest = 0;
+}
+
+void BarHistoryDestroy (BarHistory_t * const h) {
+	for (size_t i = 0; i < h->count; i++) {
+		PianoDestroyPlaylist (BarHistoryGet (h, i));
+	}
+	free (h->songs);
+	BarHistoryInit (h, h->capacity);
+}
+
+/*	add song, which must not be part of a list. Takes ownership; the song is
+ *	destroyed right away if the history is disabled.
+ */
+void BarHistoryPrepend (BarHistory_t * const h, PianoSong_t * const song) {
+	assert (h != NULL);
+	assert (song != NULL);
+	/* make sure it's a single song */
+	assert (PianoListNextP (song) == NULL);
+
+	if (h->capacity == 0) {
+		PianoDestroyPlaylist (song);
+		return;
+	}
+
+	if (h->songs == NULL) {
+		/* allocated on first use, 0 is a valid setting */
+		if ((h->songs = calloc (h->capacity, sizeof (*h->songs))) == NULL) {
+			PianoDestroyPlaylist (song);
+			return;
+		}
+		/* first song goes into slot 0 */
+		h->newest = h->capacity - 1;
+	}
+
+	h->newest = (h->newest + 1) % h->capacity;
+	if (h->count == h->capacity) {
+		/* evict the oldest song, which occupies the slot */
+		PianoDestroyPlaylist (h->songs[h->newest]);
+	} else {
+		++h->count;
+	}
+	h->songs[h->newest] = song;
+}
+
+/*	get nth song, 0 is the newest
+ *	@return song or NULL
+ */
+PianoSong_t *BarHistoryGet (const BarHistory_t * const h, const size_t n) {
+	assert (h != NULL);
+
+	if (n >= h->count) {
+		return NULL;
+	}
+	return h->songs[(h->newest + h->capacity - n) % h->capacity];
+}
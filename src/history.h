@@ -0,0 +1,47 @@
+/*
+Copyright (c) 2020
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "config.h"
+
+#include <stddef.h>
+
+#include <piano.h>
+
+/* recently played songs, newest first. Fixed capacity ring, the oldest song
+ * is evicted once it is full. */
+typedef struct {
+	/* ring buffer of capacity slots */
+	PianoSong_t **songs;
+	size_t capacity;
+	/* songs stored */
+	size_t count;
+	/* slot of the newest song */
+	size_t newest;
+} BarHistory_t;
+
+void BarHistoryInit (BarHistory_t * const, const size_t);
+void BarHistoryDestroy (BarHistory_t * const);
+void BarHistoryPrepend (BarHistory_t * const, PianoSong_t * const);
+PianoSong_t *BarHistoryGet (const BarHistory_t * const, const size_t);
@@ -129,11 +129,11 @@ static void ShmemTouch (void) {
 }
 
 void BarShmemSetStrings (const PianoStation_t *curStation, const PianoSong_t *curSong,
-		PianoStation_t *stations) {
+		const PianoHandle_t *ph) {
 	if (shmem == NULL) return;
 	if (curStation == NULL) return;
 	if (curSong == NULL) return;
-	if (stations == NULL) return;
+	if (ph == NULL || ph->stations == NULL) return;
 
 	strncpy (sp.station_name, curStation->name, 127);
 	sp.station_name[127] = '\0';
@@ -147,9 +147,14 @@ void BarShmemSetStrings (const PianoStation_t *curStation, const PianoSong_t *cu
 	sp.current_song_coverart[511] = '\0';
 
 	if (curStation->isQuickMix) {
-		PianoStation_t *songStation = PianoFindStationById (stations, curSong->stationId);
-		strncpy (sp.current_song_station, songStation->name, 127);
-		sp.current_song_station[127] = '\0';
+		PianoStation_t *songStation = PianoFindStationById (ph, curSong->stationId);
+		/* the station may have been deleted in the meantime */
+		if (songStation != NULL) {
+			strncpy (sp.current_song_station, songStation->name, 127);
+			sp.current_song_station[127] = '\0';
+		} else {
+			sp.current_song_station[0] = '\0';
+		}
 	} else {
 		strncpy (sp.station_name, curStation->name, 127);
 		sp.station_name[127] = '\0';
@@ -159,9 +164,13 @@ void BarShmemSetStrings (const PianoStation_t *curStation, const PianoSong_t *cu
 	PianoSong_t * const nextSong = PianoListNextP (curSong);
 	if (nextSong != NULL) {
 		if (curStation->isQuickMix) {
-			PianoStation_t *ss = PianoFindStationById (stations, nextSong->stationId);
-			strncpy (sp.next_song_station, ss->name, 127);
-			sp.next_song_station[127] = '\0';
+			PianoStation_t *ss = PianoFindStationById (ph, nextSong->stationId);
+			if (ss != NULL) {
+				strncpy (sp.next_song_station, ss->name, 127);
+				sp.next_song_station[127] = '\0';
+			} else {
+				sp.next_song_station[0] = '\0';
+			}
 		} else {
 			sp.next_song_station[0] = '\0';
 		}
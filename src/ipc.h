@@ -2,5 +2,5 @@
 
 void BarShmemInit (BarApp_t *app, char *binPath);
 void BarShmemSetStrings (const PianoStation_t *curStation, const PianoSong_t *curSong,
-		PianoStation_t *stations);
+		const PianoHandle_t *ph);
 void BarShmemSetTimes (BarApp_t *app);
@@ -0,0 +1,235 @@
+/*
+Copyright (c) 2020
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* region allocator: everything belonging to a single request (post data,
+ * encryption buffers, response body) is carved out of a few large blocks
+ * and released at once. */
+
+#include "../config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+
+#include "piano.h"
+
+#define PIANO_ARENA_BLOCK 4096
+
+/* maximum alignment, c99 has no max_align_t */
+typedef union {
+	long double d;
+	long long int l;
+	void *p;
+	void (*f) (void);
+} PianoArenaAlign_t;
+
+#define PIANO_ARENA_ALIGN (sizeof (PianoArenaAlign_t))
+
+typedef struct PianoArenaBlock {
+	struct PianoArenaBlock *next;
+	size_t size, used;
+	/* aligned start of data */
+	PianoArenaAlign_t data[];
+} PianoArenaBlock_t;
+
+struct PianoArena {
+	/* current block first */
+	PianoArenaBlock_t *blocks;
+	/* most recent allocation, can be resized in place */
+	void *last;
+	size_t allocs, numBlocks, bytes;
+	/* see PianoArenaRef */
+	size_t refs;
+};
+
+static size_t PianoArenaRound (const size_t size) {
+	return (size + PIANO_ARENA_ALIGN - 1) / PIANO_ARENA_ALIGN *
+			PIANO_ARENA_ALIGN;
+}
+
+static PianoArenaBlock_t *PianoArenaAddBlock (PianoArena_t * const a,
+		const size_t minSize) {
+	const size_t size = minSize > PIANO_ARENA_BLOCK ? minSize :
+			PIANO_ARENA_BLOCK;
+	PianoArenaBlock_t * const b = malloc (sizeof (*b) + size);
+	if (b == NULL) {
+		return NULL;
+	}
+	b->size = size;
+	b->used = 0;
+	b->next = a->blocks;
+	a->blocks = b;
+	++a->numBlocks;
+	a->bytes += size;
+	return b;
+}
+
+/*	create arena, the first block can hold at least hint bytes
+ */
+PianoArena_t *PianoArenaNew (const size_t hint) {
+	PianoArena_t * const a = calloc (1, sizeof (*a));
+	if (a == NULL) {
+		return NULL;
+	}
+	a->refs = 1;
+	if (PianoArenaAddBlock (a, PianoArenaRound (hint)) == NULL) {
+		free (a);
+		return NULL;
+	}
+	return a;
+}
+
+void *PianoArenaAlloc (PianoArena_t * const a, const size_t size) {
+	assert (a != NULL);
+
+	const size_t rounded = PianoArenaRound (size > 0 ? size : 1);
+	PianoArenaBlock_t *b = a->blocks;
+	if (b->size - b->used < rounded) {
+		if ((b = PianoArenaAddBlock (a, rounded)) == NULL) {
+			return NULL;
+		}
+	}
+	void * const p = (char *) b->data + b->used;
+	b->used += rounded;
+	++a->allocs;
+	a->last = p;
+	return p;
+}
+
+/*	zeroed allocation
+ */
+void *PianoArenaCalloc (PianoArena_t * const a, const size_t size) {
+	void * const p = PianoArenaAlloc (a, size);
+	if (p != NULL) {
+		memset (p, 0, size);
+	}
+	return p;
+}
+
+/*	resize allocation p. Grows in place if p is the most recent allocation
+ *	and there is enough room, copies otherwise.
+ */
+void *PianoArenaRealloc (PianoArena_t * const a, void * const p,
+		const size_t oldSize, const size_t newSize) {
+	assert (a != NULL);
+
+	if (p == NULL) {
+		return PianoArenaAlloc (a, newSize);
+	}
+
+	PianoArenaBlock_t * const b = a->blocks;
+	if (p == a->last) {
+		const size_t offset = (char *) p - (char *) b->data;
+		const size_t rounded = PianoArenaRound (newSize);
+		if (b->size - offset >= rounded) {
+			b->used = offset + rounded;
+			return p;
+		}
+	}
+
+	void * const n = PianoArenaAlloc (a, newSize);
+	if (n != NULL) {
+		memcpy (n, p, oldSize < newSize ? oldSize : newSize);
+	}
+	return n;
+}
+
+char *PianoArenaStrdup (PianoArena_t * const a, const char * const s) {
+	const size_t len = strlen (s) + 1;
+	char * const d = PianoArenaAlloc (a, len);
+	if (d != NULL) {
+		memcpy (d, s, len);
+	}
+	return d;
+}
+
+/*	move all memory owned by src into dst and destroy src. Pointers into src
+ *	stay valid.
+ */
+void PianoArenaAdopt (PianoArena_t * const dst, PianoArena_t * const src) {
+	assert (dst != NULL);
+
+	if (src == NULL) {
+		return;
+	}
+
+	/* append behind dst’s current block, so it stays current */
+	PianoArenaBlock_t *tail = src->blocks;
+	while (tail->next != NULL) {
+		tail = tail->next;
+	}
+	tail->next = dst->blocks->next;
+	dst->blocks->next = src->blocks;
+
+	dst->allocs += src->allocs;
+	dst->numBlocks += src->numBlocks;
+	dst->bytes += src->bytes;
+	free (src);
+}
+
+/*	number of allocations served, blocks (i.e. malloc calls) and bytes
+ *	reserved
+ */
+void PianoArenaStats (const PianoArena_t * const a, size_t * const allocs,
+		size_t * const blocks, size_t * const bytes) {
+	*allocs = a->allocs;
+	*blocks = a->numBlocks;
+	*bytes = a->bytes;
+}
+
+void PianoArenaDestroy (PianoArena_t * const a) {
+	if (a == NULL) {
+		return;
+	}
+
+	PianoArenaBlock_t *b = a->blocks;
+	while (b != NULL) {
+		PianoArenaBlock_t * const next = b->next;
+		free (b);
+		b = next;
+	}
+	free (a);
+}
+
+/*	take another reference. Objects parsed from one response (songs,
+ *	stations, artists) are allocated from the same arena and each hold a
+ *	reference, so they can still be destroyed one by one.
+ */
+PianoArena_t *PianoArenaRef (PianoArena_t * const a) {
+	assert (a != NULL);
+	++a->refs;
+	return a;
+}
+
+/*	drop a reference, the arena is destroyed with the last one
+ */
+void PianoArenaUnref (PianoArena_t * const a) {
+	if (a == NULL) {
+		return;
+	}
+	assert (a->refs > 0);
+	if (--a->refs == 0) {
+		PianoArenaDestroy (a);
+	}
+}
@@ -26,9 +26,114 @@ THE SOFTWARE.
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "crypt.h"
 
+/* nibble to lowercase hex digit */
+static const char hexDigits[16] = "0123456789abcdef";
+
+/* hex digit to nibble, valid digits are marked with HEX_VALID */
+#define HEX_VALID 0x10
+#define HEX(n) (HEX_VALID | (n))
+static const uint8_t hexValues[256] = {
+		['0'] = HEX(0), ['1'] = HEX(1), ['2'] = HEX(2), ['3'] = HEX(3),
+		['4'] = HEX(4), ['5'] = HEX(5), ['6'] = HEX(6), ['7'] = HEX(7),
+		['8'] = HEX(8), ['9'] = HEX(9),
+		['a'] = HEX(10), ['b'] = HEX(11), ['c'] = HEX(12), ['d'] = HEX(13),
+		['e'] = HEX(14), ['f'] = HEX(15),
+		['A'] = HEX(10), ['B'] = HEX(11), ['C'] = HEX(12), ['D'] = HEX(13),
+		['E'] = HEX(14), ['F'] = HEX(15),
+		};
+
+#ifdef __SSE2__
+/*	nibbles (0…15) in every byte to lowercase hex digits
+ */
+static inline __m128i PianoHexDigits (const __m128i n) {
+	const __m128i alpha = _mm_and_si128 (_mm_cmpgt_epi8 (n,
+			_mm_set1_epi8 (9)), _mm_set1_epi8 ('a' - '0' - 10));
+	return _mm_add_epi8 (_mm_add_epi8 (n, _mm_set1_epi8 ('0')), alpha);
+}
+#endif
+
+/*	hex-encode len bytes from in to out (2*len characters, no NUL). in may
+ *	overlap the upper half of out, bytes are read before their slot is
+ *	written.
+ */
+static void PianoHexEncode (char * const out, const unsigned char * const in,
+		const size_t len) {
+	size_t i = 0;
+
+#ifdef __SSE2__
+	const __m128i mask = _mm_set1_epi8 (0x0f);
+	for (; i + 16 <= len; i += 16) {
+		const __m128i v = _mm_loadu_si128 ((const __m128i *) &in[i]);
+		const __m128i hi = _mm_and_si128 (_mm_srli_epi16 (v, 4), mask);
+		const __m128i lo = _mm_and_si128 (v, mask);
+		_mm_storeu_si128 ((__m128i *) &out[i*2],
+				PianoHexDigits (_mm_unpacklo_epi8 (hi, lo)));
+		_mm_storeu_si128 ((__m128i *) &out[i*2+16],
+				PianoHexDigits (_mm_unpackhi_epi8 (hi, lo)));
+	}
+#endif
+
+	for (; i < len; i++) {
+		const unsigned char c = in[i];
+		out[i*2] = hexDigits[c >> 4];
+		out[i*2+1] = hexDigits[c & 0x0f];
+	}
+}
+
+/*	decode 2*len hex digits from in to len bytes in out
+ *	@return false if in contains anything but hex digits
+ */
+static bool PianoHexDecode (unsigned char * restrict const out,
+		const char * restrict const in, const size_t len) {
+	size_t i = 0;
+
+#ifdef __SSE2__
+	for (; i + 8 <= len; i += 8) {
+		const __m128i v = _mm_loadu_si128 ((const __m128i *) &in[i*2]);
+		/* digits: c-'0', letters: (c|0x20)-'a'+10 */
+		const __m128i lower = _mm_or_si128 (v, _mm_set1_epi8 (0x20));
+		/* signed compares, bytes >= 0x80 are never valid */
+		const __m128i digit = _mm_and_si128 (
+				_mm_cmpgt_epi8 (v, _mm_set1_epi8 ('0' - 1)),
+				_mm_cmplt_epi8 (v, _mm_set1_epi8 ('9' + 1)));
+		const __m128i letter = _mm_and_si128 (
+				_mm_cmpgt_epi8 (lower, _mm_set1_epi8 ('a' - 1)),
+				_mm_cmplt_epi8 (lower, _mm_set1_epi8 ('f' + 1)));
+		if (_mm_movemask_epi8 (_mm_or_si128 (digit, letter)) != 0xffff) {
+			return false;
+		}
+		const __m128i alpha = _mm_and_si128 (_mm_cmpgt_epi8 (lower,
+				_mm_set1_epi8 ('9')), _mm_set1_epi8 ('a' - '0' - 10));
+		const __m128i n = _mm_and_si128 (_mm_sub_epi8 (_mm_sub_epi8 (lower,
+				_mm_set1_epi8 ('0')), alpha), _mm_set1_epi8 (0x0f));
+		/* every 16 bit lane holds a high (low byte) and low (high byte)
+		 * nibble */
+		const __m128i bytes = _mm_or_si128 (
+				_mm_slli_epi16 (_mm_and_si128 (n, _mm_set1_epi16 (0x000f)), 4),
+				_mm_srli_epi16 (n, 8));
+		_mm_storel_epi64 ((__m128i *) &out[i], _mm_packus_epi16 (bytes,
+				bytes));
+	}
+#endif
+
+	for (; i < len; i++) {
+		const uint8_t hi = hexValues[(unsigned char) in[i*2]],
+				lo = hexValues[(unsigned char) in[i*2+1]];
+		if (!(hi & lo & HEX_VALID)) {
+			return false;
+		}
+		out[i] = ((hi & 0x0f) << 4) | (lo & 0x0f);
+	}
+	return true;
+}
+
 /*	decrypt hex-encoded, blowfish-crypted string: decode 2 hex-encoded blocks,
  *	decrypt, byteswap
  *	@param gcrypt handle
@@ -38,24 +143,25 @@ THE SOFTWARE.
  */
 char *PianoDecryptString (gcry_cipher_hd_t h, const char * const input,
 		size_t * const retSize) {
-	size_t inputLen = strlen (input);
-	gcry_error_t gret;
-	unsigned char *output;
-	size_t outputLen = inputLen/2;
-
-	assert (inputLen%2 == 0);
-
-	output = calloc (outputLen+1, sizeof (*output));
-	/* hex decode */
-	for (size_t i = 0; i < outputLen; i++) {
-		char hex[3];
-		memcpy (hex, &input[i*2], 2);
-		hex[2] = '\0';
-		output[i] = strtol (hex, NULL, 16);
+	const size_t inputLen = strlen (input);
+	const size_t outputLen = inputLen/2;
+
+	if (inputLen%2 != 0) {
+		return NULL;
 	}
 
-	gret = gcry_cipher_decrypt (h, output, outputLen, NULL, 0);
-	if (gret) {
+	unsigned char * const output = malloc (outputLen+1);
+	if (output == NULL) {
+		return NULL;
+	}
+	if (!PianoHexDecode (output, input, outputLen)) {
+		free (output);
+		return NULL;
+	}
+	output[outputLen] = '\0';
+
+	/* in place */
+	if (gcry_cipher_decrypt (h, output, outputLen, NULL, 0)) {
 		free (output);
 		return NULL;
 	}
@@ -68,31 +174,34 @@ char *PianoDecryptString (gcry_cipher_hd_t h, const char * const input,
 /*	blowfish-encrypt/hex-encode string
  *	@param gcrypt handle
  *	@param encrypt this
- *	@return encrypted, hex-encoded string
+ *	@param allocate buffers here
+ *	@return encrypted, hex-encoded string, owned by arena
  */
-char *PianoEncryptString (gcry_cipher_hd_t h, const char *s) {
-	unsigned char *paddedInput, *hexOutput;
-	size_t inputLen = strlen (s);
+char *PianoEncryptString (gcry_cipher_hd_t h, const char *s,
+		PianoArena_t * const arena) {
+	const size_t inputLen = strlen (s);
 	/* blowfish expects two 32 bit blocks */
-	size_t paddedInputLen = (inputLen % 8 == 0) ? inputLen : inputLen + (8-inputLen%8);
-	gcry_error_t gret;
-
-	paddedInput = calloc (paddedInputLen+1, sizeof (*paddedInput));
-	memcpy (paddedInput, s, inputLen);
+	const size_t paddedInputLen = (inputLen % 8 == 0) ? inputLen :
+			inputLen + (8-inputLen%8);
 
-	gret = gcry_cipher_encrypt (h, paddedInput, paddedInputLen, NULL, 0);
-	if (gret) {
-		free (paddedInput);
+	/* the padded input is encrypted in place in the upper half of the output
+	 * and then hex-encoded over itself */
+	char * const hexOutput = PianoArenaAlloc (arena, paddedInputLen*2+1);
+	if (hexOutput == NULL) {
 		return NULL;
 	}
+	unsigned char * const paddedInput = (unsigned char *) hexOutput +
+			paddedInputLen;
+	memcpy (paddedInput, s, inputLen);
+	memset (paddedInput + inputLen, 0, paddedInputLen - inputLen);
 
-	hexOutput = calloc (paddedInputLen*2+1, sizeof (*hexOutput));
-	for (size_t i = 0; i < paddedInputLen; i++) {
-		snprintf ((char * restrict) &hexOutput[i*2], 3, "%02x", paddedInput[i]);
+	if (gcry_cipher_encrypt (h, paddedInput, paddedInputLen, NULL, 0)) {
+		return NULL;
 	}
 
-	free (paddedInput);
+	PianoHexEncode (hexOutput, paddedInput, paddedInputLen);
+	hexOutput[paddedInputLen*2] = '\0';
 
-	return (char *) hexOutput;
+	return hexOutput;
 }
 
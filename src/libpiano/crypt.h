@@ -28,7 +28,11 @@ THE SOFTWARE.
 #endif
 #include <gcrypt.h>
 
+#include "piano.h"
+
 char *PianoDecryptString (gcry_cipher_hd_t, const char * const,
 		size_t * const);
-char *PianoEncryptString (gcry_cipher_hd_t, const char *);
+
+char *PianoEncryptString (gcry_cipher_hd_t, const char *,
+		PianoArena_t * const);
 
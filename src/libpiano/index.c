@@ -0,0 +1,209 @@
+/*
+Copyright (c) 2020
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* open-addressing hash from station id to station, kept in sync with
+ * ph->stations. Linear probing with backward-shift deletion, so there are
+ * no tombstones. If the table cannot be (re)allocated it is dropped and
+ * lookups fall back to walking the list. */
+
+#include "../config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "piano_private.h"
+#include "piano.h"
+
+#define PIANO_INDEX_MINSIZE 16
+
+/*	FNV-1a
+ */
+static uint32_t PianoIndexHash (const char *s) {
+	uint32_t h = 2166136261u;
+	while (*s != '\0') {
+		h ^= (unsigned char) *s++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+/*	insert station into table, which must have a free slot
+ */
+static void PianoIndexPut (PianoStationIndex_t * const idx,
+		PianoStation_t * const station, const uint32_t hash) {
+	const size_t mask = idx->size-1;
+	size_t i = hash & mask;
+	while (idx->slots[i].station != NULL) {
+		i = (i+1) & mask;
+	}
+	idx->slots[i].station = station;
+	idx->slots[i].hash = hash;
+	++idx->count;
+}
+
+/*	rebuild index from station list
+ */
+static void PianoIndexRebuild (PianoHandle_t * const ph) {
+	PianoStationIndex_t * const idx = &ph->stationIndex;
+	const size_t n = ph->stations == NULL ? 0 : PianoListCountP (ph->stations);
+	size_t size = PIANO_INDEX_MINSIZE;
+	/* keep the load factor below 1/2 */
+	while (size < n*2) {
+		size *= 2;
+	}
+
+	free (idx->slots);
+	idx->count = 0;
+	if ((idx->slots = calloc (size, sizeof (*idx->slots))) == NULL) {
+		idx->size = 0;
+		return;
+	}
+	idx->size = size;
+
+	PianoStation_t *curr = ph->stations;
+	PianoListForeachP (curr) {
+		if (curr->id != NULL) {
+			PianoIndexPut (idx, curr, PianoIndexHash (curr->id));
+		}
+	}
+}
+
+/*	find slot holding station, or idx->size
+ */
+static size_t PianoIndexSlot (const PianoStationIndex_t * const idx,
+		const PianoStation_t * const station) {
+	const size_t mask = idx->size-1;
+	size_t i = PianoIndexHash (station->id) & mask;
+	while (idx->slots[i].station != NULL) {
+		if (idx->slots[i].station == station) {
+			return i;
+		}
+		i = (i+1) & mask;
+	}
+	return idx->size;
+}
+
+/*	add station, which must already be linked into ph->stations
+ */
+void PianoStationIndexInsert (PianoHandle_t * const ph,
+		PianoStation_t * const station) {
+	PianoStationIndex_t * const idx = &ph->stationIndex;
+
+	assert (station != NULL);
+
+	if (station->id == NULL) {
+		return;
+	}
+
+	if (idx->size == 0 || (idx->count+1)*2 > idx->size) {
+		/* picks up station from the list */
+		PianoIndexRebuild (ph);
+	} else {
+		PianoIndexPut (idx, station, PianoIndexHash (station->id));
+	}
+}
+
+/*	remove station, before it is unlinked from ph->stations
+ */
+void PianoStationIndexRemove (PianoHandle_t * const ph,
+		const PianoStation_t * const station) {
+	PianoStationIndex_t * const idx = &ph->stationIndex;
+
+	assert (station != NULL);
+
+	if (idx->size == 0 || station->id == NULL) {
+		return;
+	}
+
+	const size_t found = PianoIndexSlot (idx, station);
+	if (found == idx->size) {
+		return;
+	}
+
+	/* move following entries of the probe sequence into the hole */
+	const size_t mask = idx->size-1;
+	size_t hole = found, i = found;
+	idx->slots[hole].station = NULL;
+	--idx->count;
+	while (true) {
+		i = (i+1) & mask;
+		if (idx->slots[i].station == NULL) {
+			break;
+		}
+		const size_t home = idx->slots[i].hash & mask;
+		/* entry can move if its home slot is not within (hole, i] */
+		if (((i - home) & mask) >= ((i - hole) & mask)) {
+			idx->slots[hole] = idx->slots[i];
+			idx->slots[i].station = NULL;
+			hole = i;
+		}
+	}
+}
+
+void PianoStationIndexDestroy (PianoStationIndex_t * const idx) {
+	free (idx->slots);
+	memset (idx, 0, sizeof (*idx));
+}
+
+/*	get station from list by id
+ *	@param piano handle
+ *	@param search for this
+ *	@return the station structure matching the given id
+ */
+PianoStation_t *PianoFindStationById (const PianoHandle_t * const ph,
+		const char * const searchStation) {
+	assert (ph != NULL);
+
+	if (searchStation == NULL) {
+		return NULL;
+	}
+
+	const PianoStationIndex_t * const idx = &ph->stationIndex;
+	if (idx->size == 0) {
+		PianoStation_t *currStation = ph->stations;
+		PianoListForeachP (currStation) {
+			if (currStation->id != NULL &&
+					strcmp (currStation->id, searchStation) == 0) {
+				return currStation;
+			}
+		}
+		return NULL;
+	}
+
+	const uint32_t hash = PianoIndexHash (searchStation);
+	const size_t mask = idx->size-1;
+	size_t i = hash & mask;
+	while (idx->slots[i].station != NULL) {
+		const char * const id = idx->slots[i].station->id;
+		/* song station ids are interned, just like station ids */
+		if (id == searchStation ||
+				(idx->slots[i].hash == hash && strcmp (id, searchStation) == 0)) {
+			return idx->slots[i].station;
+		}
+		i = (i+1) & mask;
+	}
+
+	return NULL;
+}
@@ -0,0 +1,176 @@
+/*
+Copyright (c) 2020
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* interned, reference counted strings. Artist and album names, station ids
+ * and the station id of every song repeat a lot across playlists, history
+ * and search results; they are stored once per handle. Each string is
+ * preceded by its table entry, so releasing it needs no handle and strings
+ * may outlive the table. */
+
+#include "../config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "piano_private.h"
+#include "piano.h"
+
+#define PIANO_INTERN_MINSIZE 64
+
+struct PianoInternEntry {
+	struct PianoInternEntry *next;
+	/* NULL after the table was destroyed */
+	PianoIntern_t *table;
+	uint32_t hash;
+	unsigned int refs;
+	char str[];
+};
+
+typedef struct PianoInternEntry PianoInternEntry_t;
+
+static PianoInternEntry_t *PianoInternEntryOf (const char * const s) {
+	return (PianoInternEntry_t *) (s - offsetof (PianoInternEntry_t, str));
+}
+
+/*	FNV-1a, also returns the length
+ */
+static uint32_t PianoInternHash (const char *s, size_t * const len) {
+	uint32_t h = 2166136261u;
+	const char * const start = s;
+	while (*s != '\0') {
+		h ^= (unsigned char) *s++;
+		h *= 16777619u;
+	}
+	*len = s - start;
+	return h;
+}
+
+/*	double the number of buckets
+ */
+static void PianoInternGrow (PianoIntern_t * const t) {
+	const size_t size = t->size == 0 ? PIANO_INTERN_MINSIZE : t->size*2;
+	PianoInternEntry_t ** const buckets = calloc (size, sizeof (*buckets));
+	if (buckets == NULL) {
+		/* keep going with longer chains */
+		return;
+	}
+
+	for (size_t i = 0; i < t->size; i++) {
+		PianoInternEntry_t *e = t->buckets[i];
+		while (e != NULL) {
+			PianoInternEntry_t * const next = e->next;
+			const size_t k = e->hash & (size-1);
+			e->next = buckets[k];
+			buckets[k] = e;
+			e = next;
+		}
+	}
+	free (t->buckets);
+	t->buckets = buckets;
+	t->size = size;
+}
+
+/*	get a reference to the interned copy of s
+ *	@return string, which must be released with PianoInternRelease, or NULL
+ */
+char *PianoIntern (PianoIntern_t * const t, const char * const s) {
+	assert (t != NULL);
+
+	if (s == NULL) {
+		return NULL;
+	}
+
+	if (t->count >= t->size) {
+		PianoInternGrow (t);
+		if (t->size == 0) {
+			return NULL;
+		}
+	}
+
+	size_t len;
+	const uint32_t hash = PianoInternHash (s, &len);
+	PianoInternEntry_t **bucket = &t->buckets[hash & (t->size-1)];
+	for (PianoInternEntry_t *e = *bucket; e != NULL; e = e->next) {
+		if (e->hash == hash && strcmp (e->str, s) == 0) {
+			++e->refs;
+			return e->str;
+		}
+	}
+
+	PianoInternEntry_t * const e = malloc (sizeof (*e) + len + 1);
+	if (e == NULL) {
+		return NULL;
+	}
+	memcpy (e->str, s, len + 1);
+	e->table = t;
+	e->hash = hash;
+	e->refs = 1;
+	e->next = *bucket;
+	*bucket = e;
+	++t->count;
+
+	return e->str;
+}
+
+/*	drop a reference to an interned string, NULL is ignored
+ */
+void PianoInternRelease (char * const s) {
+	if (s == NULL) {
+		return;
+	}
+
+	PianoInternEntry_t * const e = PianoInternEntryOf (s);
+	assert (e->refs > 0);
+	if (--e->refs > 0) {
+		return;
+	}
+
+	PianoIntern_t * const t = e->table;
+	if (t != NULL) {
+		PianoInternEntry_t **prev = &t->buckets[e->hash & (t->size-1)];
+		while (*prev != e) {
+			assert (*prev != NULL);
+			prev = &(*prev)->next;
+		}
+		*prev = e->next;
+		--t->count;
+	}
+	free (e);
+}
+
+/*	destroy table, strings still referenced stay valid
+ */
+void PianoInternDestroy (PianoIntern_t * const t) {
+	for (size_t i = 0; i < t->size; i++) {
+		PianoInternEntry_t *e = t->buckets[i];
+		while (e != NULL) {
+			e->table = NULL;
+			e = e->next;
+		}
+	}
+	free (t->buckets);
+	memset (t, 0, sizeof (*t));
+}
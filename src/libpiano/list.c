@@ -110,3 +110,36 @@ size_t PianoListCount (const PianoListHead_t * const l) {
 	return count;
 }
 
+/*	initialize list builder b from existing list l (may be NULL), walking it
+ *	once to find its tail
+ */
+void PianoListInit (PianoList_t * const b, PianoListHead_t * const l) {
+	assert (b != NULL);
+
+	b->head = b->tail = l;
+	b->count = 0;
+
+	PianoListHead_t *curr = l;
+	PianoListForeach (curr) {
+		b->tail = curr;
+		++b->count;
+	}
+}
+
+/*	append element e to builder b in constant time, return new list head
+ */
+void *PianoListPush (PianoList_t * const b, PianoListHead_t * const e) {
+	assert (b != NULL);
+	assert (e != NULL);
+	assert (e->next == NULL);
+
+	if (b->tail == NULL) {
+		b->head = e;
+	} else {
+		b->tail->next = e;
+	}
+	b->tail = e;
+	++b->count;
+
+	return b->head;
+}
@@ -72,12 +72,16 @@ static void PianoDestroyArtists (PianoArtist_t *artists) {
 
 	curArtist = artists;
 	while (curArtist != NULL) {
-		free (curArtist->name);
-		free (curArtist->musicId);
-		free (curArtist->seedId);
 		lastArtist = curArtist;
 		curArtist = (PianoArtist_t *) curArtist->head.next;
-		free (lastArtist);
+		PianoInternRelease (lastArtist->name);
+		if (lastArtist->arena != NULL) {
+			PianoArenaUnref (lastArtist->arena);
+		} else {
+			free (lastArtist->musicId);
+			free (lastArtist->seedId);
+			free (lastArtist);
+		}
 	}
 }
 
@@ -90,20 +94,37 @@ void PianoDestroySearchResult (PianoSearchResult_t *searchResult) {
 	PianoDestroyPlaylist (searchResult->songs);
 }
 
-/*	free single station
+/*	free single station, including the structure itself
  *	@param station
  */
 void PianoDestroyStation (PianoStation_t *station) {
-	free (station->name);
-	free (station->id);
-	free (station->seedId);
-	memset (station, 0, sizeof (*station));
+	PianoInternRelease (station->id);
+	if (station->arena != NULL) {
+		PianoArenaUnref (station->arena);
+	} else {
+		free (station->name);
+		free (station->seedId);
+		free (station);
+	}
+}
+
+/*	replace station name
+ */
+void PianoStationSetName (PianoStation_t * const station,
+		const char * const name) {
+	if (station->arena != NULL) {
+		/* the old name is released with the arena */
+		station->name = PianoArenaStrdup (station->arena, name);
+	} else {
+		free (station->name);
+		station->name = strdup (name);
+	}
 }
 
 /*	free complete station list
- *	@param piano handle
+ *	@param stations
  */
-static void PianoDestroyStations (PianoStation_t *stations) {
+void PianoDestroyStations (PianoStation_t *stations) {
 	PianoStation_t *curStation, *lastStation;
 
 	curStation = stations;
@@ -111,7 +132,6 @@ static void PianoDestroyStations (PianoStation_t *stations) {
 		lastStation = curStation;
 		curStation = (PianoStation_t *) curStation->head.next;
 		PianoDestroyStation (lastStation);
-		free (lastStation);
 	}
 }
 
@@ -125,13 +145,19 @@ void PianoDestroyPlaylist (PianoSong_t *playlist) {
 
 	curSong = playlist;
 	while (curSong != NULL) {
+		PianoInternRelease (curSong->artist);
+		PianoInternRelease (curSong->stationId);
+		PianoInternRelease (curSong->album);
+		if (curSong->arena != NULL) {
+			lastSong = curSong;
+			curSong = (PianoSong_t *) curSong->head.next;
+			PianoArenaUnref (lastSong->arena);
+			continue;
+		}
 		free (curSong->audioUrl);
 		free (curSong->coverArt);
-		free (curSong->artist);
 		free (curSong->musicId);
 		free (curSong->title);
-		free (curSong->stationId);
-		free (curSong->album);
 		free (curSong->feedbackId);
 		free (curSong->seedId);
 		free (curSong->detailUrl);
@@ -164,6 +190,20 @@ static void PianoDestroyGenres (PianoGenre_t *genres) {
 	}
 }
 
+/*	destroy genre station categories
+ */
+void PianoDestroyGenreStations (PianoGenreCategory_t *genreStations) {
+	PianoGenreCategory_t *curGenreCat = genreStations, *lastGenreCat;
+
+	while (curGenreCat != NULL) {
+		PianoDestroyGenres (curGenreCat->genres);
+		free (curGenreCat->name);
+		lastGenreCat = curGenreCat;
+		curGenreCat = (PianoGenreCategory_t *) curGenreCat->head.next;
+		free (lastGenreCat);
+	}
+}
+
 /*	destroy user information
  */
 void PianoDestroyUserInfo (PianoUserInfo_t *user) {
@@ -201,52 +241,25 @@ void PianoDestroyStationMode (PianoStationMode_t * const modes) {
  */
 void PianoDestroy (PianoHandle_t *ph) {
 	PianoDestroyUserInfo (&ph->user);
+	PianoStationIndexDestroy (&ph->stationIndex);
 	PianoDestroyStations (ph->stations);
+	/* strings still held by the application stay valid */
+	PianoInternDestroy (&ph->strings);
 	PianoDestroyPartner (&ph->partner);
-	/* destroy genre stations */
-	PianoGenreCategory_t *curGenreCat = ph->genreStations, *lastGenreCat;
-	while (curGenreCat != NULL) {
-		PianoDestroyGenres (curGenreCat->genres);
-		free (curGenreCat->name);
-		lastGenreCat = curGenreCat;
-		curGenreCat = (PianoGenreCategory_t *) curGenreCat->head.next;
-		free (lastGenreCat);
-	}
+	PianoDestroyGenreStations (ph->genreStations);
 	memset (ph, 0, sizeof (*ph));
 }
 
-/*	destroy request, free post data. req->responseData is *not* freed here, as
- *	it might be allocated by something else than malloc!
+/*	destroy request, free post data and everything else owned by its arena.
+ *	req->responseData is freed only if the arena owns it.
  *	@param piano request
  */
 void PianoDestroyRequest (PianoRequest_t *req) {
-	free (req->postData);
+	PianoArenaDestroy (req->arena);
+	PianoResponseParserDestroy (req->responseParser);
 	memset (req, 0, sizeof (*req));
 }
 
-/*	get station from list by id
- *	@param search here
- *	@param search for this
- *	@return the first station structure matching the given id
- */
-PianoStation_t *PianoFindStationById (PianoStation_t * const stations,
-		const char * const searchStation) {
-	assert (stations != NULL);
-
-	if (searchStation == NULL) {
-		return NULL;
-	}
-
-	PianoStation_t *currStation = stations;
-	PianoListForeachP (currStation) {
-		if (strcmp (currStation->id, searchStation) == 0) {
-			return currStation;
-		}
-	}
-
-	return NULL;
-}
-
 /*	convert return value to human-readable string
  *	@param enum
  *	@return error string
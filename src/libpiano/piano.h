@@ -26,6 +26,7 @@ THE SOFTWARE.
 #include "../config.h"
 
 #include <stdbool.h>
+#include <stdint.h>
 #ifdef __FreeBSD__
 #define _GCRYPT_IN_LIBGCRYPT
 #endif
@@ -47,6 +48,9 @@ typedef struct PianoListHead {
 	struct PianoListHead *next;
 } PianoListHead_t;
 
+/* region allocator, opaque */
+typedef struct PianoArena PianoArena_t;
+
 typedef struct PianoUserInfo {
 	char *listenerId;
 	char *authToken;
@@ -57,9 +61,12 @@ typedef struct PianoStation {
 	char isCreator;
 	char isQuickMix;
 	char useQuickMix; /* station will be included in quickmix */
+	char seen; /* used while merging a refreshed station list */
 	char *name;
-	char *id;
+	char *id; /* interned */
 	char *seedId;
+	/* owns the structure and other strings if not NULL */
+	PianoArena_t *arena;
 } PianoStation_t;
 
 typedef enum {
@@ -85,9 +92,9 @@ typedef enum {
 
 typedef struct PianoSong {
 	PianoListHead_t head;
-	char *artist;
-	char *stationId;
-	char *album;
+	char *artist; /* interned */
+	char *stationId; /* interned */
+	char *album; /* interned */
 	char *audioUrl;
 	char *coverArt;
 	char *musicId;
@@ -100,15 +107,19 @@ typedef struct PianoSong {
 	unsigned int length; /* song length in seconds */
 	PianoSongRating_t rating;
 	PianoAudioFormat_t audioFormat;
+	/* owns the structure and other strings if not NULL */
+	PianoArena_t *arena;
 } PianoSong_t;
 
 /* currently only used for search results */
 typedef struct PianoArtist {
 	PianoListHead_t head;
-	char *name;
+	char *name; /* interned */
 	char *musicId;
 	char *seedId;
 	int score;
+	/* owns the structure and other strings if not NULL */
+	PianoArena_t *arena;
 } PianoArtist_t;
 
 typedef struct PianoGenre {
@@ -129,10 +140,27 @@ typedef struct PianoPartner {
 	unsigned int id;
 } PianoPartner_t;
 
+/* station id hash table, see index.c */
+typedef struct {
+	struct {
+		PianoStation_t *station;
+		uint32_t hash;
+	} *slots;
+	size_t size, count;
+} PianoStationIndex_t;
+
+/* interned strings, see intern.c */
+typedef struct {
+	struct PianoInternEntry **buckets;
+	size_t size, count;
+} PianoIntern_t;
+
 typedef struct PianoHandle {
 	PianoUserInfo_t user;
 	/* linked lists */
 	PianoStation_t *stations;
+	PianoStationIndex_t stationIndex;
+	PianoIntern_t strings;
 	PianoGenreCategory_t *genreStations;
 	PianoPartner_t partner;
 	int timeOffset;
@@ -190,13 +218,22 @@ typedef enum {
 	PIANO_REQUEST_SET_STATION_MODE = 26,
 } PianoRequestType_t;
 
+/* incremental response parser, opaque */
+typedef struct PianoResponseParser PianoResponseParser_t;
+
 typedef struct PianoRequest {
 	PianoRequestType_t type;
 	bool secure;
 	void *data;
 	char urlPath[1024];
+	/* owns postData, plainData and responseData */
+	PianoArena_t *arena;
 	char *postData;
+	/* postData before encryption */
+	char *plainData;
 	char *responseData;
+	/* responseData parsed while downloading, optional */
+	PianoResponseParser_t *responseParser;
 } PianoRequest_t;
 
 /* request data structures */
@@ -212,6 +249,16 @@ typedef struct {
 	PianoSong_t *retPlaylist;
 } PianoRequestDataGetPlaylist_t;
 
+/* optional, without it stations missing from the response are kept */
+typedef struct {
+	/* unlink stations missing from the response */
+	bool prune;
+	/* unlinked stations, owned by the caller */
+	PianoStation_t *retRemoved;
+	/* stations were added, removed or renamed */
+	bool retChanged;
+} PianoRequestDataGetStations_t;
+
 typedef struct {
 	PianoSong_t *song;
 	PianoSongRating_t rating;
@@ -365,6 +412,17 @@ void *PianoListPrepend (PianoListHead_t * const l, PianoListHead_t * const e)
 void *PianoListGet (PianoListHead_t * const l, const size_t n);
 #define PianoListGetP(l,n) PianoListGet (&(l)->head, n)
 #define PianoListForeachP(l) for (; (l) != NULL; (l) = (void *) (l)->head.next)
+/* keeps track of the tail and length of a list while it is built, elements
+ * are still linked through PianoListHead_t. Stored lists are plain element
+ * pointers shared with library users, so tail and count live here instead. */
+typedef struct {
+	PianoListHead_t *head, *tail;
+	size_t count;
+} PianoList_t;
+void PianoListInit (PianoList_t * const b, PianoListHead_t * const l);
+#define PianoListInitP(b,l) PianoListInit (b, ((l) == NULL) ? NULL : &(l)->head)
+void *PianoListPush (PianoList_t * const b, PianoListHead_t * const e);
+#define PianoListPushP(b,e) PianoListPush (b, &(e)->head)
 
 /* memory management */
 PianoReturn_t PianoInit (PianoHandle_t *, const char *,
@@ -373,17 +431,36 @@ PianoReturn_t PianoInit (PianoHandle_t *, const char *,
 void PianoDestroy (PianoHandle_t *);
 void PianoDestroyPlaylist (PianoSong_t *);
 void PianoDestroySearchResult (PianoSearchResult_t *);
+void PianoDestroyStations (PianoStation_t *);
 void PianoDestroyStationInfo (PianoStationInfo_t *);
 void PianoDestroyStationMode (PianoStationMode_t * const);
+void PianoDestroyGenreStations (PianoGenreCategory_t *);
 
 /* pandora rpc */
 PianoReturn_t PianoRequest (PianoHandle_t *, PianoRequest_t *,
 		PianoRequestType_t);
 PianoReturn_t PianoResponse (PianoHandle_t *, PianoRequest_t *);
+PianoResponseParser_t *PianoResponseParserNew (void);
+bool PianoResponseParserFeed (PianoResponseParser_t * const, const char * const,
+		const size_t);
+size_t PianoResponseParserSize (const PianoResponseParser_t * const);
+void PianoResponseParserDestroy (PianoResponseParser_t * const);
+PianoArena_t *PianoArenaNew (const size_t);
+void *PianoArenaAlloc (PianoArena_t * const, const size_t);
+void *PianoArenaCalloc (PianoArena_t * const, const size_t);
+void *PianoArenaRealloc (PianoArena_t * const, void * const, const size_t,
+		const size_t);
+char *PianoArenaStrdup (PianoArena_t * const, const char * const);
+void PianoArenaAdopt (PianoArena_t * const, PianoArena_t * const);
+void PianoArenaStats (const PianoArena_t * const, size_t * const,
+		size_t * const, size_t * const);
+void PianoArenaDestroy (PianoArena_t * const);
+PianoArena_t *PianoArenaRef (PianoArena_t * const);
+void PianoArenaUnref (PianoArena_t * const);
 void PianoDestroyRequest (PianoRequest_t *);
 
 /* misc */
-PianoStation_t *PianoFindStationById (PianoStation_t * const,
+PianoStation_t *PianoFindStationById (const PianoHandle_t * const,
 		const char * const);
 const char *PianoErrorToStr (PianoReturn_t);
 
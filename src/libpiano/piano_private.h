@@ -26,5 +26,13 @@ THE SOFTWARE.
 #include "piano.h"
 
 void PianoDestroyStation (PianoStation_t *station);
+void PianoStationSetName (PianoStation_t * const, const char * const);
 void PianoDestroyUserInfo (PianoUserInfo_t *user);
+void PianoStationIndexInsert (PianoHandle_t * const, PianoStation_t * const);
+void PianoStationIndexRemove (PianoHandle_t * const,
+		const PianoStation_t * const);
+void PianoStationIndexDestroy (PianoStationIndex_t * const);
+char *PianoIntern (PianoIntern_t * const, const char * const);
+void PianoInternRelease (char * const);
+void PianoInternDestroy (PianoIntern_t * const);
 
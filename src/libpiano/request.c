@@ -529,13 +529,21 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 
 	/* json to string */
 	jsonSendBuf = json_object_to_json_string (j);
-	if (encrypted) {
-		if ((req->postData = PianoEncryptString (ph->partner.out,
-				jsonSendBuf)) == NULL) {
-			ret = PIANO_RET_OUT_OF_MEMORY;
-		}
-	} else {
-		req->postData = strdup (jsonSendBuf);
+	const size_t jsonLen = strlen (jsonSendBuf);
+	/* room for the plain text, hex-encoded ciphertext and scratch space */
+	if (req->arena == NULL &&
+			(req->arena = PianoArenaNew (jsonLen*4+32)) == NULL) {
+		ret = PIANO_RET_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+	if ((req->plainData = PianoArenaStrdup (req->arena,
+			jsonSendBuf)) == NULL) {
+		ret = PIANO_RET_OUT_OF_MEMORY;
+	} else if (!encrypted) {
+		req->postData = req->plainData;
+	} else if ((req->postData = PianoEncryptString (ph->partner.out,
+			jsonSendBuf, req->arena)) == NULL) {
+		ret = PIANO_RET_OUT_OF_MEMORY;
 	}
 
 cleanup:
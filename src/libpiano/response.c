@@ -45,6 +45,37 @@ static char *PianoJsonStrdup (json_object *j, const char *key) {
 	}
 }
 
+/*	like PianoJsonStrdup, but return an interned string
+ */
+static char *PianoJsonIntern (PianoHandle_t * const ph, json_object *j,
+		const char *key) {
+	assert (j != NULL);
+	assert (key != NULL);
+
+	json_object *v;
+	if (json_object_object_get_ex (j, key, &v)) {
+		return PianoIntern (&ph->strings, json_object_get_string (v));
+	} else {
+		return NULL;
+	}
+}
+
+/*	like PianoJsonStrdup, but copy into arena a
+ */
+static char *PianoJsonArenaStrdup (PianoArena_t * const a, json_object *j,
+		const char *key) {
+	assert (a != NULL);
+	assert (j != NULL);
+	assert (key != NULL);
+
+	json_object *v;
+	if (json_object_object_get_ex (j, key, &v)) {
+		return PianoArenaStrdup (a, json_object_get_string (v));
+	} else {
+		return NULL;
+	}
+}
+
 static bool getBoolDefault (json_object * const j, const char * const key, const bool def) {
 	assert (j != NULL);
 	assert (key != NULL);
@@ -57,11 +88,20 @@ static bool getBoolDefault (json_object * const j, const char * const key, const
 	}
 }
 
-static void PianoJsonParseStation (json_object *j, PianoStation_t *s) {
-	s->name = PianoJsonStrdup (j, "stationName");
-	s->id = PianoJsonStrdup (j, "stationToken");
+/*	parse station into arena a. The station does not hold a reference to
+ *	a until it is linked into a list.
+ */
+static PianoStation_t *PianoJsonParseStation (PianoHandle_t * const ph,
+		PianoArena_t * const a, json_object *j) {
+	PianoStation_t * const s = PianoArenaCalloc (a, sizeof (*s));
+	if (s == NULL) {
+		return NULL;
+	}
+	s->name = PianoJsonArenaStrdup (a, j, "stationName");
+	s->id = PianoJsonIntern (ph, j, "stationToken");
 	s->isCreator = !getBoolDefault (j, "isShared", !false);
 	s->isQuickMix = getBoolDefault (j, "isQuickMix", false);
+	return s;
 }
 
 /*	concat strings
@@ -88,10 +128,117 @@ static void PianoStrpcat (char * restrict dest, const char * restrict src,
 	*dest = '\0';
 }
 
+struct PianoResponseParser {
+	json_tokener *tok;
+	/* complete document and its approximate size in memory */
+	json_object *result;
+	size_t size;
+	bool failed;
+};
+
+/*	approximate memory used by document j. json-c does not expose its
+ *	allocations, so this counts nodes, hash entries, array slots and string
+ *	contents.
+ */
+static size_t PianoJsonSize (json_object * const j) {
+	/* json_object plus malloc overhead */
+	static const size_t node = 64;
+	/* lh_entry and key */
+	static const size_t entry = 48;
+	size_t size = node;
+
+	switch (json_object_get_type (j)) {
+		case json_type_object: {
+			json_object_object_foreach (j, key, val) {
+				size += entry + strlen (key) + 1;
+				if (val != NULL) {
+					size += PianoJsonSize (val);
+				}
+			}
+			break;
+		}
+
+		case json_type_array: {
+			const size_t len = json_object_array_length (j);
+			for (size_t i = 0; i < len; i++) {
+				json_object * const val = json_object_array_get_idx (j, i);
+				size += sizeof (val);
+				if (val != NULL) {
+					size += PianoJsonSize (val);
+				}
+			}
+			break;
+		}
+
+		case json_type_string:
+			size += json_object_get_string_len (j) + 1;
+			break;
+
+		default:
+			break;
+	}
+
+	return size;
+}
+
+/*	create parser for a response that arrives in chunks
+ */
+PianoResponseParser_t *PianoResponseParserNew (void) {
+	PianoResponseParser_t * const p = calloc (1, sizeof (*p));
+	if (p == NULL) {
+		return NULL;
+	}
+	if ((p->tok = json_tokener_new ()) == NULL) {
+		free (p);
+		return NULL;
+	}
+	return p;
+}
+
+/*	parse the next chunk of a response
+ *	@return false if the response is invalid
+ */
+bool PianoResponseParserFeed (PianoResponseParser_t * const p,
+		const char * const data, const size_t len) {
+	assert (p != NULL);
+
+	if (p->failed) {
+		return false;
+	}
+	if (p->result != NULL) {
+		/* trailing data, usually a newline */
+		return true;
+	}
+
+	p->result = json_tokener_parse_ex (p->tok, data, (int) len);
+	if (p->result == NULL &&
+			json_tokener_get_error (p->tok) != json_tokener_continue) {
+		p->failed = true;
+	} else if (p->result != NULL) {
+		p->size = PianoJsonSize (p->result);
+	}
+	return !p->failed;
+}
+
+/*	approximate size of the parsed document, 0 until it is complete
+ */
+size_t PianoResponseParserSize (const PianoResponseParser_t * const p) {
+	return p == NULL ? 0 : p->size;
+}
+
+void PianoResponseParserDestroy (PianoResponseParser_t * const p) {
+	if (p == NULL) {
+		return;
+	}
+	json_object_put (p->result);
+	json_tokener_free (p->tok);
+	free (p);
+}
+
 /*	parse xml response and update data structures/return new data structure
  *	@param piano handle
  *	@param initialized request (expects responseData to be a NUL-terminated
- *			string)
+ *			string or responseParser to hold the parsed document)
  */
 PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 	PianoReturn_t ret = PIANO_RET_OK;
@@ -99,7 +246,14 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 	assert (ph != NULL);
 	assert (req != NULL);
 
-	json_object * const j = json_tokener_parse (req->responseData);
+	json_object *j;
+	if (req->responseParser != NULL && req->responseParser->result != NULL) {
+		/* already parsed while downloading, take ownership */
+		j = req->responseParser->result;
+		req->responseParser->result = NULL;
+	} else {
+		j = json_tokener_parse (req->responseData);
+	}
 
 	json_object *status;
 	if (!json_object_object_get_ex (j, "stat", &status)) {
@@ -170,6 +324,7 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 					}
 					free (decryptedTimestamp);
 					/* get auth token */
+					free (ph->partner.authToken);
 					ph->partner.authToken = PianoJsonStrdup (result,
 							"partnerAuthToken");
 					json_object *partnerId;
@@ -197,7 +352,8 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 		}
 
 		case PIANO_REQUEST_GET_STATIONS: {
-			/* get stations */
+			/* get stations, merging them into the known ones by id */
+			PianoRequestDataGetStations_t * const reqData = req->data;
 			assert (req->responseData != NULL);
 
 			json_object *stations, *mix = NULL;
@@ -206,38 +362,138 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 				break;
 			}
 
-			for (int i = 0; i < json_object_array_length (stations); i++) {
-				PianoStation_t *tmpStation;
-				json_object *s = json_object_array_get_idx (stations, i);
-
-				if ((tmpStation = calloc (1, sizeof (*tmpStation))) == NULL) {
-					return PIANO_RET_OUT_OF_MEMORY;
+			/* the list may be refreshed; known stations are updated in place,
+			 * the application holds pointers to them. Only new stations are
+			 * allocated, sharing a single arena. */
+			const int stationCount = json_object_array_length (stations);
+			size_t newCount = 0;
+			for (int i = 0; i < stationCount; i++) {
+				json_object *s = json_object_array_get_idx (stations, i), *token;
+				if (!json_object_object_get_ex (s, "stationToken", &token) ||
+						PianoFindStationById (ph,
+						json_object_get_string (token)) == NULL) {
+					++newCount;
 				}
+			}
+			PianoArena_t *arena = NULL;
+			if (newCount > 0 && (arena = PianoArenaNew (newCount *
+					(sizeof (PianoStation_t) + 96))) == NULL) {
+				ret = PIANO_RET_OUT_OF_MEMORY;
+				break;
+			}
 
-				PianoJsonParseStation (s, tmpStation);
+			PianoList_t list;
+			PianoListInitP (&list, ph->stations);
+			PianoStation_t *curStation = ph->stations;
+			PianoListForeachP (curStation) {
+				curStation->seen = false;
+			}
+			for (int i = 0; i < stationCount; i++) {
+				json_object *s = json_object_array_get_idx (stations, i), *v;
 
-				if (tmpStation->isQuickMix) {
+				if (getBoolDefault (s, "isQuickMix", false)) {
 					/* fix flags on other stations later */
 					json_object_object_get_ex (s, "quickMixStationIds", &mix);
 				}
 
+				PianoStation_t * const known =
+						json_object_object_get_ex (s, "stationToken", &v) ?
+						PianoFindStationById (ph, json_object_get_string (v)) :
+						NULL;
+				if (known != NULL) {
+					if (json_object_object_get_ex (s, "stationName", &v)) {
+						const char * const name = json_object_get_string (v);
+						if (known->name == NULL ||
+								strcmp (known->name, name) != 0) {
+							PianoStationSetName (known, name);
+							if (reqData != NULL) {
+								reqData->retChanged = true;
+							}
+						}
+					}
+					const bool isCreator = !getBoolDefault (s, "isShared", !false),
+							isQuickMix = getBoolDefault (s, "isQuickMix", false);
+					if (reqData != NULL && (known->isCreator != isCreator ||
+							known->isQuickMix != isQuickMix)) {
+						reqData->retChanged = true;
+					}
+					known->isCreator = isCreator;
+					known->isQuickMix = isQuickMix;
+					known->seen = true;
+					continue;
+				}
+
+				/* at most newCount stations end up here */
+				assert (arena != NULL);
+				PianoStation_t * const tmpStation = PianoJsonParseStation (ph,
+						arena, s);
+				if (tmpStation == NULL) {
+					ret = PIANO_RET_OUT_OF_MEMORY;
+					break;
+				}
 				/* start new linked list or append */
-				ph->stations = PianoListAppendP (ph->stations, tmpStation);
+				tmpStation->arena = PianoArenaRef (arena);
+				tmpStation->seen = true;
+				ph->stations = PianoListPushP (&list, tmpStation);
+				PianoStationIndexInsert (ph, tmpStation);
+				if (reqData != NULL) {
+					reqData->retChanged = true;
+				}
+			}
+			PianoArenaUnref (arena);
+			if (ret != PIANO_RET_OK) {
+				break;
 			}
 
-			/* fix quickmix flags */
-			if (mix != NULL) {
-				PianoStation_t *curStation = ph->stations;
-				PianoListForeachP (curStation) {
-					for (int i = 0; i < json_object_array_length (mix); i++) {
-						json_object *id = json_object_array_get_idx (mix, i);
-						if (strcmp (json_object_get_string (id),
-								curStation->id) == 0) {
-							curStation->useQuickMix = true;
+			/* unlink stations deleted elsewhere in one pass */
+			if (reqData != NULL && reqData->prune) {
+				PianoList_t removed;
+				PianoListInit (&removed, NULL);
+				PianoStation_t *prev = NULL, *s = ph->stations;
+				while (s != NULL) {
+					PianoStation_t * const next = PianoListNextP (s);
+					if (s->seen) {
+						prev = s;
+					} else {
+						if (prev == NULL) {
+							ph->stations = next;
+						} else {
+							prev->head.next = s->head.next;
 						}
+						s->head.next = NULL;
+						PianoStationIndexRemove (ph, s);
+						reqData->retRemoved = PianoListPushP (&removed, s);
+						reqData->retChanged = true;
+					}
+					s = next;
+				}
+			}
+
+			/* fix quickmix flags, members are resolved through the station
+			 * index. A response without quickmix has no members. The merge
+			 * is done, so seen marks membership now. */
+			curStation = ph->stations;
+			PianoListForeachP (curStation) {
+				curStation->seen = false;
+			}
+			if (mix != NULL) {
+				for (int i = 0; i < json_object_array_length (mix); i++) {
+					json_object *id = json_object_array_get_idx (mix, i);
+					PianoStation_t * const member = PianoFindStationById (ph,
+							json_object_get_string (id));
+					if (member != NULL) {
+						member->seen = true;
 					}
 				}
 			}
+			curStation = ph->stations;
+			PianoListForeachP (curStation) {
+				if (reqData != NULL &&
+						curStation->useQuickMix != curStation->seen) {
+					reqData->retChanged = true;
+				}
+				curStation->useQuickMix = curStation->seen;
+			}
 			break;
 		}
 
@@ -256,19 +512,30 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 			}
 			assert (items != NULL);
 
+			/* all songs and their strings share a single arena */
+			PianoArena_t * const arena = PianoArenaNew (
+					json_object_array_length (items) *
+					(sizeof (PianoSong_t) + 1024));
+			if (arena == NULL) {
+				ret = PIANO_RET_OUT_OF_MEMORY;
+				break;
+			}
+
+			PianoList_t list;
+			PianoListInitP (&list, playlist);
 			for (int i = 0; i < json_object_array_length (items); i++) {
 				json_object *s = json_object_array_get_idx (items, i);
 				PianoSong_t *song;
 
-				if ((song = calloc (1, sizeof (*song))) == NULL) {
-					return PIANO_RET_OUT_OF_MEMORY;
-				}
-
 				if (!json_object_object_get_ex (s, "artistName", NULL)) {
-					free (song);
 					continue;
 				}
 
+				if ((song = PianoArenaCalloc (arena, sizeof (*song))) == NULL) {
+					ret = PIANO_RET_OUT_OF_MEMORY;
+					break;
+				}
+
 				/* get audio url based on selected quality */
 				static const char *qualityMap[] = {"", "lowQuality", "mediumQuality",
 						"highQuality"};
@@ -290,24 +557,24 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 								break;
 							}
 						}
-						song->audioUrl = PianoJsonStrdup (qmap, "audioUrl");
+						song->audioUrl = PianoJsonArenaStrdup (arena, qmap,
+								"audioUrl");
 					} else {
 						/* requested quality is not available */
 						ret = PIANO_RET_QUALITY_UNAVAILABLE;
-						free (song);
-						PianoDestroyPlaylist (playlist);
-						goto cleanup;
+						break;
 					}
 				}
 
 				json_object *v;
-				song->artist = PianoJsonStrdup (s, "artistName");
-				song->album = PianoJsonStrdup (s, "albumName");
-				song->title = PianoJsonStrdup (s, "songName");
-				song->trackToken = PianoJsonStrdup (s, "trackToken");
-				song->stationId = PianoJsonStrdup (s, "stationId");
-				song->coverArt = PianoJsonStrdup (s, "albumArtUrl");
-				song->detailUrl = PianoJsonStrdup (s, "songDetailUrl");
+				song->artist = PianoJsonIntern (ph, s, "artistName");
+				song->album = PianoJsonIntern (ph, s, "albumName");
+				song->title = PianoJsonArenaStrdup (arena, s, "songName");
+				song->trackToken = PianoJsonArenaStrdup (arena, s, "trackToken");
+				song->stationId = PianoJsonIntern (ph, s, "stationId");
+				song->coverArt = PianoJsonArenaStrdup (arena, s, "albumArtUrl");
+				song->detailUrl = PianoJsonArenaStrdup (arena, s,
+						"songDetailUrl");
 				song->fileGain = json_object_object_get_ex (s, "trackGain", &v) ?
 						json_object_get_double (v) : 0.0;
 				song->length = json_object_object_get_ex (s, "trackLength", &v) ?
@@ -319,9 +586,15 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 						break;
 				}
 
-				playlist = PianoListAppendP (playlist, song);
+				song->arena = PianoArenaRef (arena);
+				playlist = PianoListPushP (&list, song);
 			}
+			PianoArenaUnref (arena);
 
+			if (ret != PIANO_RET_OK) {
+				PianoDestroyPlaylist (playlist);
+				break;
+			}
 			reqData->retPlaylist = playlist;
 			break;
 		}
@@ -346,8 +619,7 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 			assert (reqData->station != NULL);
 			assert (reqData->newName != NULL);
 
-			free (reqData->station->name);
-			reqData->station->name = strdup (reqData->newName);
+			PianoStationSetName (reqData->station, reqData->newName);
 			break;
 		}
 
@@ -357,9 +629,9 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 
 			assert (station != NULL);
 
+			PianoStationIndexRemove (ph, station);
 			ph->stations = PianoListDeleteP (ph->stations, station);
 			PianoDestroyStation (station);
-			free (station);
 			break;
 		}
 
@@ -374,65 +646,93 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 			searchResult = &reqData->searchResult;
 			memset (searchResult, 0, sizeof (*searchResult));
 
+			/* artists and songs share a single arena */
+			PianoArena_t * const arena = PianoArenaNew (4096);
+			if (arena == NULL) {
+				ret = PIANO_RET_OUT_OF_MEMORY;
+				break;
+			}
+
 			/* get artists */
 			json_object *artists;
 			if (json_object_object_get_ex (result, "artists", &artists)) {
+				PianoList_t list;
+				PianoListInit (&list, NULL);
 				for (int i = 0; i < json_object_array_length (artists); i++) {
 					json_object *a = json_object_array_get_idx (artists, i);
 					PianoArtist_t *artist;
 
-					if ((artist = calloc (1, sizeof (*artist))) == NULL) {
-						return PIANO_RET_OUT_OF_MEMORY;
+					if ((artist = PianoArenaCalloc (arena,
+							sizeof (*artist))) == NULL) {
+						ret = PIANO_RET_OUT_OF_MEMORY;
+						break;
 					}
 
-					artist->name = PianoJsonStrdup (a, "artistName");
-					artist->musicId = PianoJsonStrdup (a, "musicToken");
+					artist->name = PianoJsonIntern (ph, a, "artistName");
+					artist->musicId = PianoJsonArenaStrdup (arena, a,
+							"musicToken");
 
-					searchResult->artists =
-							PianoListAppendP (searchResult->artists, artist);
+					artist->arena = PianoArenaRef (arena);
+					searchResult->artists = PianoListPushP (&list, artist);
 				}
 			}
 
 			/* get songs */
 			json_object *songs;
-			if (json_object_object_get_ex (result, "songs", &songs)) {
+			if (ret == PIANO_RET_OK &&
+					json_object_object_get_ex (result, "songs", &songs)) {
+				PianoList_t list;
+				PianoListInit (&list, NULL);
 				for (int i = 0; i < json_object_array_length (songs); i++) {
 					json_object *s = json_object_array_get_idx (songs, i);
 					PianoSong_t *song;
 
-					if ((song = calloc (1, sizeof (*song))) == NULL) {
-						return PIANO_RET_OUT_OF_MEMORY;
+					if ((song = PianoArenaCalloc (arena,
+							sizeof (*song))) == NULL) {
+						ret = PIANO_RET_OUT_OF_MEMORY;
+						break;
 					}
 
-					song->title = PianoJsonStrdup (s, "songName");
-					song->artist = PianoJsonStrdup (s, "artistName");
-					song->musicId = PianoJsonStrdup (s, "musicToken");
+					song->title = PianoJsonArenaStrdup (arena, s, "songName");
+					song->artist = PianoJsonIntern (ph, s, "artistName");
+					song->musicId = PianoJsonArenaStrdup (arena, s, "musicToken");
 
-					searchResult->songs =
-							PianoListAppendP (searchResult->songs, song);
+					song->arena = PianoArenaRef (arena);
+					searchResult->songs = PianoListPushP (&list, song);
 				}
 			}
+			PianoArenaUnref (arena);
+
+			if (ret != PIANO_RET_OK) {
+				PianoDestroySearchResult (searchResult);
+				memset (searchResult, 0, sizeof (*searchResult));
+			}
 			break;
 		}
 
 		case PIANO_REQUEST_CREATE_STATION: {
 			/* create station, insert new station into station list on success */
 			PianoStation_t *tmpStation;
+			PianoArena_t * const arena = PianoArenaNew (256);
 
-			if ((tmpStation = calloc (1, sizeof (*tmpStation))) == NULL) {
-				return PIANO_RET_OUT_OF_MEMORY;
+			if (arena == NULL ||
+					(tmpStation = PianoJsonParseStation (ph, arena, result)) == NULL) {
+				PianoArenaUnref (arena);
+				ret = PIANO_RET_OUT_OF_MEMORY;
+				break;
 			}
+			/* take over the initial reference */
+			tmpStation->arena = arena;
 
-			PianoJsonParseStation (result, tmpStation);
-
-			PianoStation_t *search = PianoFindStationById (ph->stations,
+			PianoStation_t *search = PianoFindStationById (ph,
 					tmpStation->id);
 			if (search != NULL) {
+				PianoStationIndexRemove (ph, search);
 				ph->stations = PianoListDeleteP (ph->stations, search);
 				PianoDestroyStation (search);
-				free (search);
 			}
 			ph->stations = PianoListAppendP (ph->stations, tmpStation);
+			PianoStationIndexInsert (ph, tmpStation);
 			break;
 		}
 
@@ -453,9 +753,14 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 			break;
 
 		case PIANO_REQUEST_GET_GENRE_STATIONS: {
-			/* get genre stations */
+			/* get genre stations, replacing the current ones */
+			PianoDestroyGenreStations (ph->genreStations);
+			ph->genreStations = NULL;
+
 			json_object *categories;
 			if (json_object_object_get_ex (result, "categories", &categories)) {
+				PianoList_t categoryList;
+				PianoListInit (&categoryList, NULL);
 				for (int i = 0; i < json_object_array_length (categories); i++) {
 					json_object *c = json_object_array_get_idx (categories, i);
 					PianoGenreCategory_t *tmpGenreCategory;
@@ -471,6 +776,8 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 					/* get genre subnodes */
 					json_object *stations;
 					if (json_object_object_get_ex (c, "stations", &stations)) {
+						PianoList_t genreList;
+						PianoListInit (&genreList, NULL);
 						for (int k = 0;
 								k < json_object_array_length (stations); k++) {
 							json_object *s =
@@ -489,12 +796,11 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 									"stationToken");
 
 							tmpGenreCategory->genres =
-									PianoListAppendP (tmpGenreCategory->genres,
-									tmpGenre);
+									PianoListPushP (&genreList, tmpGenre);
 						}
 					}
 
-					ph->genreStations = PianoListAppendP (ph->genreStations,
+					ph->genreStations = PianoListPushP (&categoryList,
 							tmpGenreCategory);
 				}
 			}
@@ -573,6 +879,8 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 				/* songs */
 				json_object *songs;
 				if (json_object_object_get_ex (music, "songs", &songs)) {
+					PianoList_t list;
+					PianoListInitP (&list, info->songSeeds);
 					for (int i = 0; i < json_object_array_length (songs); i++) {
 						json_object *s = json_object_array_get_idx (songs, i);
 						PianoSong_t *seedSong;
@@ -583,17 +891,18 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 						}
 
 						seedSong->title = PianoJsonStrdup (s, "songName");
-						seedSong->artist = PianoJsonStrdup (s, "artistName");
+						seedSong->artist = PianoJsonIntern (ph, s, "artistName");
 						seedSong->seedId = PianoJsonStrdup (s, "seedId");
 
-						info->songSeeds = PianoListAppendP (info->songSeeds,
-								seedSong);
+						info->songSeeds = PianoListPushP (&list, seedSong);
 					}
 				}
 
 				/* artists */
 				json_object *artists;
 				if (json_object_object_get_ex (music, "artists", &artists)) {
+					PianoList_t list;
+					PianoListInitP (&list, info->artistSeeds);
 					for (int i = 0; i < json_object_array_length (artists); i++) {
 						json_object *a = json_object_array_get_idx (artists, i);
 						PianoArtist_t *seedArtist;
@@ -603,11 +912,10 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 							return PIANO_RET_OUT_OF_MEMORY;
 						}
 
-						seedArtist->name = PianoJsonStrdup (a, "artistName");
+						seedArtist->name = PianoJsonIntern (ph, a, "artistName");
 						seedArtist->seedId = PianoJsonStrdup (a, "seedId");
 
-						info->artistSeeds =
-								PianoListAppendP (info->artistSeeds, seedArtist);
+						info->artistSeeds = PianoListPushP (&list, seedArtist);
 					}
 				}
 			}
@@ -616,6 +924,8 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 			json_object *feedback;
 			if (json_object_object_get_ex (result, "feedback", &feedback)) {
 				static const char * const keys[] = {"thumbsUp", "thumbsDown"};
+				PianoList_t list;
+				PianoListInitP (&list, info->feedback);
 				for (size_t i = 0; i < sizeof (keys)/sizeof (*keys); i++) {
 					json_object *val;
 					if (!json_object_object_get_ex (feedback, keys[i], &val)) {
@@ -632,7 +942,7 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 						}
 
 						feedbackSong->title = PianoJsonStrdup (s, "songName");
-						feedbackSong->artist = PianoJsonStrdup (s,
+						feedbackSong->artist = PianoJsonIntern (ph, s,
 								"artistName");
 						feedbackSong->feedbackId = PianoJsonStrdup (s,
 								"feedbackId");
@@ -644,8 +954,7 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 								json_object_object_get_ex (s, "trackLength", &v) ?
 								json_object_get_int (v) : 0;
 
-						info->feedback = PianoListAppendP (info->feedback,
-								feedbackSong);
+						info->feedback = PianoListPushP (&list, feedbackSong);
 					}
 				}
 			}
@@ -665,6 +974,8 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 
 			json_object *availableModes;
 			if (json_object_object_get_ex (result, "availableModes", &availableModes)) {
+				PianoList_t list;
+				PianoListInitP (&list, reqData->retModes);
 				for (int i = 0; i < json_object_array_length (availableModes); i++) {
 					json_object *val = json_object_array_get_idx (availableModes, i);
 
@@ -687,8 +998,7 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 						mode->active = active == mode->id;
 					}
 
-					reqData->retModes = PianoListAppendP (reqData->retModes,
-							mode);
+					reqData->retModes = PianoListPushP (&list, mode);
 				}
 			}
 			break;
@@ -57,6 +57,7 @@ THE SOFTWARE.
 #include "ui_dispatch.h"
 #include "ui_readline.h"
 #include "ipc.h"
+#include "auth.h"
 
 /*	authenticate user
  */
@@ -71,6 +72,16 @@ static bool BarMainLoginUser (BarApp_t *app) {
 	reqData.step = 0;
 
 	BarUiMsg (&app->settings, MSG_INFO, "Login... ");
+	if (!app->settings.persistAuth) {
+		BarAuthForget (app->settings.sessionFile);
+	} else if (BarAuthLoad (&app->ph, app->settings.sessionFile,
+			reqData.user, reqData.password)) {
+		/* validated by the next call, which logs in again if necessary */
+		BarUiMsg (&app->settings, MSG_NONE, "Ok (session restored).\n");
+		BarUiStartEventCmd (&app->settings, "userlogin", NULL, NULL,
+				&app->player, NULL, PIANO_RET_OK, CURLE_OK);
+		return true;
+	}
 	ret = BarUiPianoCall (app, PIANO_REQUEST_LOGIN, &reqData, &pRet, &wRet);
 	BarUiStartEventCmd (&app->settings, "userlogin", NULL, NULL, &app->player,
 			NULL, pRet, wRet);
@@ -173,18 +184,112 @@ static bool BarMainGetStations (BarApp_t *app) {
 	bool ret;
 
 	BarUiMsg (&app->settings, MSG_INFO, "Get stations... ");
-	ret = BarUiPianoCall (app, PIANO_REQUEST_GET_STATIONS, NULL, &pRet, &wRet);
+	/* reset to 0 if the list came from a stale cache entry */
+	app->stationRefreshAfter = time (NULL) + app->settings.stationRefresh;
+	ret = BarUiPianoCallCached (app, PIANO_REQUEST_GET_STATIONS, NULL, &pRet,
+			&wRet);
 	BarUiStartEventCmd (&app->settings, "usergetstations", NULL, NULL, &app->player,
-			app->ph.stations, pRet, wRet);
+			&app->ph, pRet, wRet);
 	return ret;
 }
 
+/*	background station list refresh finished
+ */
+static void BarMainRefreshStationsCb (BarApp_t * const app,
+		const PianoRequestType_t type, void * const data,
+		const PianoReturn_t pRet, const CURLcode wRet, void * const userdata) {
+	PianoRequestDataGetStations_t * const reqData = data;
+
+	assert (app->stationRefresh == reqData);
+	app->stationRefresh = NULL;
+	if (app->stationRefreshStale) {
+		/* stations were changed locally in the meantime and the response
+		 * was discarded, repeat the refresh right away */
+		app->stationRefreshStale = false;
+		app->stationRefreshAfter = 0;
+		free (reqData);
+		return;
+	}
+	const bool ok = pRet == PIANO_RET_OK && wRet == CURLE_OK;
+	app->stationRefreshAfter = time (NULL) + app->settings.stationRefresh;
+
+	/* stations deleted elsewhere, drop our references */
+	PianoStation_t *station = reqData->retRemoved;
+	PianoListForeachP (station) {
+		debugPrint (DEBUG_UI, "station %s was removed\n", station->id);
+		if (station == app->curStation) {
+			/* let the current song finish, but do not play any more */
+			BarUiMsg (&app->settings, MSG_INFO,
+					"Station \"%s\" was deleted.\n", station->name);
+			if (app->playlist != NULL) {
+				PianoDestroyPlaylist (PianoListNextP (app->playlist));
+				app->playlist->head.next = NULL;
+			}
+			app->curStation = NULL;
+		}
+		if (station == app->nextStation) {
+			app->nextStation = NULL;
+		}
+	}
+	/* upcoming songs from removed stations (quickmix members) */
+	if (reqData->retRemoved != NULL && app->playlist != NULL) {
+		PianoSong_t *prev = app->playlist, *song = PianoListNextP (prev);
+		while (song != NULL) {
+			PianoSong_t * const next = PianoListNextP (song);
+			bool removed = false;
+			station = reqData->retRemoved;
+			PianoListForeachP (station) {
+				if (song->stationId != NULL && station->id != NULL &&
+						strcmp (song->stationId, station->id) == 0) {
+					removed = true;
+					break;
+				}
+			}
+			if (removed) {
+				prev->head.next = song->head.next;
+				song->head.next = NULL;
+				PianoDestroyPlaylist (song);
+			} else {
+				prev = song;
+			}
+			song = next;
+		}
+	}
+	PianoDestroyStations (reqData->retRemoved);
+
+	if (ok && reqData->retChanged) {
+		BarUiStartEventCmd (&app->settings, "usergetstations", NULL, NULL,
+				&app->player, &app->ph, pRet, wRet);
+	}
+
+	free (reqData);
+}
+
+/*	fetch the station list again every station_refresh seconds, or right
+ *	away if requested
+ */
+static void BarMainRefreshStations (BarApp_t * const app) {
+	if ((app->settings.stationRefresh == 0 && app->stationRefreshAfter != 0) ||
+			app->stationRefresh != NULL ||
+			time (NULL) < app->stationRefreshAfter) {
+		return;
+	}
+
+	PianoRequestDataGetStations_t * const reqData =
+			calloc (1, sizeof (*reqData));
+	assert (reqData != NULL);
+	reqData->prune = true;
+	app->stationRefresh = reqData;
+	BarUiPianoCallAsync (app, PIANO_REQUEST_GET_STATIONS, reqData,
+			BarMainRefreshStationsCb, NULL, true);
+}
+
 /*	get initial station from autostart setting or user input
  */
 static void BarMainGetInitialStation (BarApp_t *app) {
 	/* try to get autostart station */
 	if (app->settings.autostartStation != NULL) {
-		app->nextStation = PianoFindStationById (app->ph.stations,
+		app->nextStation = PianoFindStationById (&app->ph,
 				app->settings.autostartStation);
 		if (app->nextStation == NULL) {
 			BarUiMsg (&app->settings, MSG_ERR,
@@ -209,30 +314,123 @@ static void BarMainHandleUserInput (BarApp_t *app) {
 	}
 }
 
-/*	fetch new playlist
- */
-static void BarMainGetPlaylist (BarApp_t *app) {
-	PianoReturn_t pRet;
-	CURLcode wRet;
+typedef struct {
 	PianoRequestDataGetPlaylist_t reqData;
-	reqData.station = app->nextStation;
-	reqData.quality = app->settings.audioQuality;
-
-	BarUiMsg (&app->settings, MSG_INFO, "Receiving new playlist... ");
-	if (!BarUiPianoCall (app, PIANO_REQUEST_GET_PLAYLIST,
-			&reqData, &pRet, &wRet)) {
-		app->nextStation = NULL;
+	/* station the playlist was requested for. The request refers to this
+	 * private copy, since retries and re-logins rebuild it after the real
+	 * station may have been deleted or pruned. */
+	PianoStation_t station;
+	char *stationId;
+	/* background fetch, append to current playlist */
+	bool prefetch;
+} BarMainPlaylistFetch_t;
+
+/*	playlist request finished
+ */
+static void BarMainGetPlaylistCb (BarApp_t * const app,
+		const PianoRequestType_t type, void * const data,
+		const PianoReturn_t pRet, const CURLcode wRet, void * const userdata) {
+	BarMainPlaylistFetch_t * const fetch = userdata;
+	PianoRequestDataGetPlaylist_t * const reqData = data;
+
+	app->playlistFetch = false;
+
+	if (wRet == CURLE_ABORTED_BY_CALLBACK) {
+		/* shutting down */
+		PianoDestroyPlaylist (reqData->retPlaylist);
+	} else if (app->nextStation == NULL ||
+			strcmp (app->nextStation->id, fetch->stationId) != 0) {
+		/* station changed in the meantime, main loop fetches a new one */
+		debugPrint (DEBUG_UI, "discarding playlist of old station %s\n",
+				fetch->stationId);
+		PianoDestroyPlaylist (reqData->retPlaylist);
+	} else if (fetch->prefetch) {
+		if (pRet != PIANO_RET_OK || wRet != CURLE_OK) {
+			/* try again later, the regular fetch reports errors */
+			app->playlistPrefetchAfter = time (NULL) + 30;
+		} else {
+			/* append songs one by one, PianoListPush takes single items */
+			PianoList_t list;
+			PianoListInitP (&list, app->playlist);
+			PianoSong_t *song = reqData->retPlaylist;
+			while (song != NULL) {
+				PianoSong_t * const next = PianoListNextP (song);
+				song->head.next = NULL;
+				app->playlist = PianoListPushP (&list, song);
+				song = next;
+			}
+			BarUiStartEventCmd (&app->settings, "stationfetchplaylist",
+					app->curStation, app->playlist, &app->player,
+					&app->ph, pRet, wRet);
+		}
 	} else {
-		app->playlist = reqData.retPlaylist;
-		if (app->playlist == NULL) {
-			BarUiMsg (&app->settings, MSG_INFO, "No tracks left.\n");
+		if (pRet != PIANO_RET_OK || wRet != CURLE_OK) {
 			app->nextStation = NULL;
+		} else {
+			app->playlist = reqData->retPlaylist;
+			if (app->playlist == NULL) {
+				BarUiMsg (&app->settings, MSG_INFO, "No tracks left.\n");
+				app->nextStation = NULL;
+			}
 		}
+		app->curStation = app->nextStation;
+		BarUiStartEventCmd (&app->settings, "stationfetchplaylist",
+				app->curStation, app->playlist, &app->player, &app->ph,
+				pRet, wRet);
+	}
+
+	free (fetch->stationId);
+	free (fetch);
+}
+
+/*	fetch new playlist in the background. prefetched songs are silently
+ *	appended to the current playlist.
+ */
+static void BarMainGetPlaylist (BarApp_t *app, const bool prefetch) {
+	BarMainPlaylistFetch_t * const fetch = calloc (1, sizeof (*fetch));
+	assert (fetch != NULL);
+	fetch->stationId = strdup (app->nextStation->id);
+	fetch->station.id = fetch->stationId;
+	fetch->reqData.station = &fetch->station;
+	fetch->reqData.quality = app->settings.audioQuality;
+	fetch->prefetch = prefetch;
+
+	if (!prefetch) {
+		BarUiMsg (&app->settings, MSG_INFO, "Receiving new playlist... ");
+	}
+	app->playlistFetch = true;
+	BarUiPianoCallAsync (app, PIANO_REQUEST_GET_PLAYLIST, &fetch->reqData,
+			BarMainGetPlaylistCb, fetch, prefetch);
+}
+
+/*	keep at least playlist_prefetch upcoming songs in the playlist
+ */
+static void BarMainPrefetchPlaylist (BarApp_t * const app) {
+	if (app->settings.playlistPrefetch == 0 || app->playlistFetch ||
+			app->playlist == NULL || app->nextStation == NULL ||
+			app->nextStation != app->curStation ||
+			time (NULL) < app->playlistPrefetchAfter) {
+		return;
+	}
+
+	/* first song is the current one */
+	const size_t upcoming = PianoListCountP (app->playlist) - 1;
+	if (upcoming < app->settings.playlistPrefetch) {
+		debugPrint (DEBUG_UI, "prefetching playlist, %zu songs left\n",
+				upcoming);
+		BarMainGetPlaylist (app, true);
+	}
+}
+
+/*	move current song to history
+ */
+static void BarMainNextSong (BarApp_t * const app) {
+	if (app->playlist != NULL) {
+		PianoSong_t *histsong = app->playlist;
+		app->playlist = PianoListNextP (app->playlist);
+		histsong->head.next = NULL;
+		BarHistoryPrepend (&app->history, histsong);
 	}
-	app->curStation = app->nextStation;
-	BarUiStartEventCmd (&app->settings, "stationfetchplaylist",
-			app->curStation, app->playlist, &app->player, app->ph.stations,
-			pRet, wRet);
 }
 
 /*	start new player thread
@@ -245,7 +443,7 @@ static void BarMainStartPlayback (BarApp_t *app, pthread_t *playerThread) {
 	assert (curSong != NULL);
 
 	BarUiPrintSong (&app->settings, curSong, app->curStation->isQuickMix ?
-			PianoFindStationById (app->ph.stations,
+			PianoFindStationById (&app->ph,
 			curSong->stationId) : NULL);
 
 	static const char httpPrefix[] = "http://";
@@ -253,6 +451,7 @@ static void BarMainStartPlayback (BarApp_t *app, pthread_t *playerThread) {
 	if (curSong->audioUrl == NULL ||
 			strncmp (curSong->audioUrl, httpPrefix, strlen (httpPrefix)) != 0) {
 		BarUiMsg (&app->settings, MSG_ERR, "Invalid song url.\n");
+		BarMainNextSong (app);
 	} else {
 		player_t * const player = &app->player;
 		BarPlayerReset (player);
@@ -266,7 +465,7 @@ static void BarMainStartPlayback (BarApp_t *app, pthread_t *playerThread) {
 
 		/* throw event */
 		BarUiStartEventCmd (&app->settings, "songstart",
-				app->curStation, curSong, &app->player, app->ph.stations,
+				app->curStation, curSong, &app->player, &app->ph,
 				PIANO_RET_OK, CURLE_OK);
 
 		/* prevent race condition, mode must _not_ be DEAD if
@@ -284,7 +483,7 @@ static void BarMainPlayerCleanup (BarApp_t *app, pthread_t *playerThread) {
 	void *threadRet;
 
 	BarUiStartEventCmd (&app->settings, "songfinish", app->curStation,
-			app->playlist, &app->player, app->ph.stations, PIANO_RET_OK,
+			app->playlist, &app->player, &app->ph, PIANO_RET_OK,
 			CURLE_OK);
 
 	/* FIXME: pthread_join blocks everything if network connection
@@ -307,6 +506,8 @@ static void BarMainPlayerCleanup (BarApp_t *app, pthread_t *playerThread) {
 	interrupted = &app->doQuit;
 
 	app->player.mode = PLAYER_DEAD;
+
+	BarMainNextSong (app);
 }
 
 /*	print song duration
@@ -358,6 +559,11 @@ static void BarMainLoop (BarApp_t *app) {
 		return;
 	}
 
+	char * const cacheDir = BarGetXdgCacheDir (PACKAGE);
+	BarCacheInit (&app->cache, cacheDir, app->settings.username,
+			app->settings.cacheMaxAge);
+	free (cacheDir);
+
 	if (!BarMainGetStations (app)) {
 		return;
 	}
@@ -379,17 +585,12 @@ static void BarMainLoop (BarApp_t *app) {
 		 * song */
 		if (BarPlayerGetMode (player) == PLAYER_DEAD) {
 			/* what's next? */
-			if (app->playlist != NULL) {
-				PianoSong_t *histsong = app->playlist;
-				app->playlist = PianoListNextP (app->playlist);
-				histsong->head.next = NULL;
-				BarUiHistoryPrepend (app, histsong);
-			}
-			if (app->playlist == NULL && app->nextStation != NULL && !app->doQuit) {
+			if (app->playlist == NULL && app->nextStation != NULL &&
+					!app->doQuit && !app->playlistFetch) {
 				if (app->nextStation != app->curStation) {
 					BarUiPrintStation (&app->settings, app->nextStation);
 				}
-				BarMainGetPlaylist (app);
+				BarMainGetPlaylist (app, false);
 			}
 			/* song ready to play */
 			if (app->playlist != NULL) {
@@ -399,6 +600,15 @@ static void BarMainLoop (BarApp_t *app) {
 
 		BarMainHandleUserInput (app);
 
+		/* finished rpc calls */
+		BarUiPianoDispatch (app);
+
+		BarMainPrefetchPlaylist (app);
+
+		BarMainRefreshStations (app);
+
+		BarUiFeedbackFlush (app);
+
 		BarShmemSetTimes (app);
 
 		/* show time */
@@ -453,6 +663,7 @@ int main (int argc, char **argv) {
 
 	BarSettingsInit (&app.settings);
 	BarSettingsRead (&app.settings);
+	BarHistoryInit (&app.history, app.settings.history);
 
 	BarShmemInit (&app, argv[0]);
 
@@ -476,8 +687,14 @@ int main (int argc, char **argv) {
 	}
 
 	curl_global_init (CURL_GLOBAL_DEFAULT);
-	app.http = curl_easy_init ();
-	assert (app.http != NULL);
+	if (!BarRpcInit (&app.rpc, &app.settings)) {
+		return 0;
+	}
+	app.input.rpc = &app.rpc;
+
+	char * const feedbackPath = BarGetXdgConfigDir (PACKAGE "/feedback");
+	BarFeedbackInit (&app.feedback, feedbackPath);
+	free (feedbackPath);
 
 	/* init fds */
 	FD_ZERO(&app.input.set);
@@ -515,10 +732,13 @@ int main (int argc, char **argv) {
 	/* write statefile */
 	BarSettingsWrite (app.curStation, &app.settings);
 
+	BarUiPianoCancel (&app);
+	BarRpcDestroy (&app.rpc);
+	BarFeedbackDestroy (&app.feedback);
+	BarCacheDestroy (&app.cache);
 	PianoDestroy (&app.ph);
-	PianoDestroyPlaylist (app.songHistory);
+	BarHistoryDestroy (&app.history);
 	PianoDestroyPlaylist (app.playlist);
-	curl_easy_cleanup (app.http);
 	curl_global_cleanup ();
 	BarPlayerDestroy (&app.player);
 	BarSettingsDestroy (&app.settings);
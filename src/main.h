@@ -24,24 +24,44 @@ THE SOFTWARE.
 #pragma once
 
 #include <curl/curl.h>
+#include <time.h>
 
 #include <piano.h>
 
 #include "player.h"
 #include "settings.h"
 #include "ui_readline.h"
+#include "rpc.h"
+#include "feedback.h"
+#include "cache.h"
+#include "history.h"
 
 typedef struct {
 	PianoHandle_t ph;
-	CURL *http;
+	BarRpc_t rpc;
 	player_t player;
 	BarSettings_t settings;
 	/* first item is current song */
 	PianoSong_t *playlist;
-	PianoSong_t *songHistory;
+	BarHistory_t history;
 	/* station of current song and station used to fetch songs from if playlist
 	 * is empty */
 	PianoStation_t *curStation, *nextStation;
+	/* asynchronous playlist request in flight */
+	bool playlistFetch;
+	/* do not prefetch before this point in time */
+	time_t playlistPrefetchAfter;
+	/* background station list refresh in flight */
+	PianoRequestDataGetStations_t *stationRefresh;
+	/* stations were changed locally while the refresh was in flight, its
+	 * response is outdated */
+	bool stationRefreshStale;
+	/* do not refresh the station list before this point in time, 0 refreshes
+	 * at once even if periodic refreshes are disabled */
+	time_t stationRefreshAfter;
+	/* pending ratings, bookmarks, … */
+	BarFeedbackQueue_t feedback;
+	BarCache_t cache;
 	sig_atomic_t doQuit;
 	BarReadlineFds_t input;
 	unsigned int playerErrors;
@@ -0,0 +1,396 @@
+/*
+Copyright (c) 2020
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* per request type rpc metrics: latency histograms for every phase of a call
+ * (from curl’s timers and our own), bytes, errors, retries and
+ * reauthentications. Written in prometheus’ text format on demand. */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <assert.h>
+
+#include "metrics.h"
+
+static size_t BarHistogramIndex (uint64_t v) {
+	if (v >= UINT64_C(1) << 32) {
+		v = (UINT64_C(1) << 32) - 1;
+	}
+	if (v < BAR_HIST_SUB) {
+		return v;
+	}
+	unsigned int msb = BAR_HIST_SUB_BITS;
+	while (v >> (msb + 1)) {
+		++msb;
+	}
+	const unsigned int shift = msb - BAR_HIST_SUB_BITS;
+	return (shift + 1) * BAR_HIST_SUB + ((v >> shift) - BAR_HIST_SUB);
+}
+
+/*	highest value (inclusive) counted by bucket
+ */
+static uint64_t BarHistogramUpper (const size_t i) {
+	if (i < BAR_HIST_SUB) {
+		return i;
+	}
+	const unsigned int shift = i / BAR_HIST_SUB - 1;
+	const uint64_t lower = (uint64_t) (BAR_HIST_SUB + i % BAR_HIST_SUB) <<
+			shift;
+	return lower + (UINT64_C(1) << shift) - 1;
+}
+
+void BarHistogramAdd (BarHistogram_t * const h, uint64_t v) {
+	++h->counts[BarHistogramIndex (v)];
+	++h->count;
+	h->sum += v;
+	if (v > h->max) {
+		h->max = v;
+	}
+}
+
+/*	value below which fraction p (0…1) of all samples fall
+ */
+uint64_t BarHistogramPercentile (const BarHistogram_t * const h,
+		const double p) {
+	if (h->count == 0) {
+		return 0;
+	}
+	uint64_t rank = (uint64_t) (p * h->count + 0.5), seen = 0;
+	if (rank < 1) {
+		rank = 1;
+	}
+	for (size_t i = 0; i < BAR_HIST_BUCKETS; i++) {
+		seen += h->counts[i];
+		if (seen >= rank) {
+			const uint64_t upper = BarHistogramUpper (i);
+			return upper < h->max ? upper : h->max;
+		}
+	}
+	return h->max;
+}
+
+void BarMetricsInit (BarMetrics_t * const m) {
+	memset (m, 0, sizeof (*m));
+}
+
+void BarMetricsDestroy (BarMetrics_t * const m) {
+	for (size_t i = 0; i < BAR_METRICS_TYPES; i++) {
+		free (m->methods[i]);
+	}
+	memset (m, 0, sizeof (*m));
+}
+
+static BarMethodMetrics_t *BarMetricsGet (BarMetrics_t * const m,
+		const PianoRequestType_t type) {
+	if ((size_t) type >= BAR_METRICS_TYPES) {
+		return NULL;
+	}
+	if (m->methods[type] == NULL) {
+		m->methods[type] = calloc (1, sizeof (*m->methods[type]));
+	}
+	return m->methods[type];
+}
+
+/*	µs between two of curl’s timestamps
+ */
+static uint64_t BarMetricsSpan (const curl_off_t from, const curl_off_t to) {
+	return to > from ? (uint64_t) (to - from) : 0;
+}
+
+/*	record finished transfer
+ *	@param metrics
+ *	@param request type
+ *	@param curl handle, NULL if the transfer did not use the network
+ *	@param transfer result
+ *	@param duration including retries, ms
+ *	@param time spent parsing while downloading, s
+ *	@param bytes sent
+ *	@param bytes received
+ *	@param number of retries
+ */
+void BarMetricsTransfer (BarMetrics_t * const m,
+		const PianoRequestType_t type, CURL * const http, const CURLcode ret,
+		const long long total, const double parseTime, const size_t bytesOut,
+		const size_t bytesIn, const unsigned int retries) {
+	/* cancelled by the user, neither a call nor an error */
+	if (ret == CURLE_ABORTED_BY_CALLBACK) {
+		return;
+	}
+
+	BarMethodMetrics_t * const mm = BarMetricsGet (m, type);
+	if (mm == NULL) {
+		return;
+	}
+
+	++mm->calls;
+	mm->retries += retries;
+	mm->bytesOut += bytesOut;
+	mm->bytesIn += bytesIn;
+	if (ret != CURLE_OK) {
+		++mm->networkErrors;
+	}
+	BarHistogramAdd (&mm->phases[BAR_MP_TOTAL],
+			total > 0 ? (uint64_t) total * 1000 : 0);
+	if (ret == CURLE_OK) {
+		BarHistogramAdd (&mm->phases[BAR_MP_PARSE],
+				(uint64_t) (parseTime * 1e6 + 0.5));
+	}
+
+	if (http == NULL) {
+		return;
+	}
+
+	/* all relative to the start of the last attempt */
+	curl_off_t dns = 0, connect = 0, tls = 0, pretransfer = 0,
+			starttransfer = 0, end = 0;
+	long connects = 0;
+	curl_easy_getinfo (http, CURLINFO_NAMELOOKUP_TIME_T, &dns);
+	curl_easy_getinfo (http, CURLINFO_CONNECT_TIME_T, &connect);
+	curl_easy_getinfo (http, CURLINFO_APPCONNECT_TIME_T, &tls);
+	curl_easy_getinfo (http, CURLINFO_PRETRANSFER_TIME_T, &pretransfer);
+	curl_easy_getinfo (http, CURLINFO_STARTTRANSFER_TIME_T, &starttransfer);
+	curl_easy_getinfo (http, CURLINFO_TOTAL_TIME_T, &end);
+	curl_easy_getinfo (http, CURLINFO_NUM_CONNECTS, &connects);
+
+	/* reused connections skip these */
+	if (connects > 0) {
+		BarHistogramAdd (&mm->phases[BAR_MP_DNS], BarMetricsSpan (0, dns));
+		BarHistogramAdd (&mm->phases[BAR_MP_CONNECT],
+				BarMetricsSpan (dns, connect));
+		if (tls > 0) {
+			BarHistogramAdd (&mm->phases[BAR_MP_TLS],
+					BarMetricsSpan (connect, tls));
+		}
+	}
+	if (ret == CURLE_OK) {
+		BarHistogramAdd (&mm->phases[BAR_MP_SERVER],
+				BarMetricsSpan (pretransfer, starttransfer));
+		BarHistogramAdd (&mm->phases[BAR_MP_TRANSFER],
+				BarMetricsSpan (starttransfer, end));
+	}
+}
+
+/*	record PianoResponse run
+ *	@param metrics
+ *	@param request type
+ *	@param its result
+ *	@param its duration, s
+ */
+void BarMetricsResponse (BarMetrics_t * const m,
+		const PianoRequestType_t type, const PianoReturn_t ret,
+		const double duration) {
+	BarMethodMetrics_t * const mm = BarMetricsGet (m, type);
+	if (mm == NULL) {
+		return;
+	}
+	BarHistogramAdd (&mm->phases[BAR_MP_RESPONSE],
+			(uint64_t) (duration * 1e6 + 0.5));
+	if (ret != PIANO_RET_OK && ret != PIANO_RET_CONTINUE_REQUEST) {
+		++mm->pandoraErrors;
+	}
+}
+
+/*	count request repeated because of a pandora error, network errors are
+ *	retried by the transport and counted by BarMetricsTransfer
+ */
+void BarMetricsRetry (BarMetrics_t * const m, const PianoRequestType_t type) {
+	BarMethodMetrics_t * const mm = BarMetricsGet (m, type);
+	if (mm != NULL) {
+		++mm->retries;
+	}
+}
+
+void BarMetricsReauth (BarMetrics_t * const m, const PianoRequestType_t type) {
+	BarMethodMetrics_t * const mm = BarMetricsGet (m, type);
+	if (mm != NULL) {
+		++mm->reauths;
+	}
+}
+
+const char *BarMetricsMethodName (const PianoRequestType_t type) {
+	switch (type) {
+		case PIANO_REQUEST_LOGIN:
+			return "login";
+
+		case PIANO_REQUEST_GET_STATIONS:
+			return "getStations";
+
+		case PIANO_REQUEST_GET_PLAYLIST:
+			return "getPlaylist";
+
+		case PIANO_REQUEST_RATE_SONG:
+			return "rateSong";
+
+		case PIANO_REQUEST_ADD_FEEDBACK:
+			return "addFeedback";
+
+		case PIANO_REQUEST_RENAME_STATION:
+			return "renameStation";
+
+		case PIANO_REQUEST_DELETE_STATION:
+			return "deleteStation";
+
+		case PIANO_REQUEST_SEARCH:
+			return "search";
+
+		case PIANO_REQUEST_CREATE_STATION:
+			return "createStation";
+
+		case PIANO_REQUEST_ADD_SEED:
+			return "addSeed";
+
+		case PIANO_REQUEST_ADD_TIRED_SONG:
+			return "addTiredSong";
+
+		case PIANO_REQUEST_SET_QUICKMIX:
+			return "setQuickMix";
+
+		case PIANO_REQUEST_GET_GENRE_STATIONS:
+			return "getGenreStations";
+
+		case PIANO_REQUEST_TRANSFORM_STATION:
+			return "transformStation";
+
+		case PIANO_REQUEST_EXPLAIN:
+			return "explain";
+
+		case PIANO_REQUEST_BOOKMARK_SONG:
+			return "bookmarkSong";
+
+		case PIANO_REQUEST_BOOKMARK_ARTIST:
+			return "bookmarkArtist";
+
+		case PIANO_REQUEST_GET_STATION_INFO:
+			return "getStationInfo";
+
+		case PIANO_REQUEST_DELETE_FEEDBACK:
+			return "deleteFeedback";
+
+		case PIANO_REQUEST_DELETE_SEED:
+			return "deleteSeed";
+
+		case PIANO_REQUEST_GET_SETTINGS:
+			return "getSettings";
+
+		case PIANO_REQUEST_CHANGE_SETTINGS:
+			return "changeSettings";
+
+		case PIANO_REQUEST_GET_STATION_MODES:
+			return "getStationModes";
+
+		case PIANO_REQUEST_SET_STATION_MODE:
+			return "setStationMode";
+
+		default:
+			return "unknown";
+	}
+}
+
+const char *BarMetricsPhaseName (const BarMetricsPhase_t phase) {
+	static const char *names[BAR_MP_COUNT] = {"dns", "connect", "tls",
+			"server", "transfer", "parse", "response", "total"};
+	assert (phase < BAR_MP_COUNT);
+	return names[phase];
+}
+
+#define writeCounter(name, help, field) \
+	fputs ("# HELP " name " " help "\n# TYPE " name " counter\n", fd); \
+	for (size_t i = 0; i < BAR_METRICS_TYPES; i++) { \
+		const BarMethodMetrics_t * const mm = m->methods[i]; \
+		if (mm != NULL) { \
+			fprintf (fd, name "{method=\"%s\"} %" PRIu64 "\n", \
+					BarMetricsMethodName (i), (uint64_t) mm->field); \
+		} \
+	}
+
+/*	write all metrics in prometheus’ text exposition format
+ */
+void BarMetricsWrite (const BarMetrics_t * const m, FILE * const fd) {
+	writeCounter ("pianobar_rpc_calls_total", "Finished rpc transfers.",
+			calls);
+	writeCounter ("pianobar_rpc_network_errors_total",
+			"Transfers that failed after all retries.", networkErrors);
+	writeCounter ("pianobar_rpc_pandora_errors_total",
+			"Responses with an error code.", pandoraErrors);
+	writeCounter ("pianobar_rpc_retries_total", "Repeated requests.",
+			retries);
+	writeCounter ("pianobar_rpc_reauths_total",
+			"Requests that required a new login.", reauths);
+	writeCounter ("pianobar_rpc_sent_bytes_total", "Request bodies.",
+			bytesOut);
+	writeCounter ("pianobar_rpc_received_bytes_total", "Response bodies.",
+			bytesIn);
+
+	fputs ("# HELP pianobar_rpc_duration_seconds Duration of each phase of "
+			"an rpc call.\n"
+			"# TYPE pianobar_rpc_duration_seconds histogram\n", fd);
+	for (size_t i = 0; i < BAR_METRICS_TYPES; i++) {
+		const BarMethodMetrics_t * const mm = m->methods[i];
+		if (mm == NULL) {
+			continue;
+		}
+		const char * const method = BarMetricsMethodName (i);
+		for (size_t p = 0; p < BAR_MP_COUNT; p++) {
+			const BarHistogram_t * const h = &mm->phases[p];
+			const char * const phase = BarMetricsPhaseName (p);
+			if (h->count == 0) {
+				continue;
+			}
+			/* cumulative, empty buckets are left out */
+			uint64_t seen = 0;
+			for (size_t b = 0; b < BAR_HIST_BUCKETS; b++) {
+				if (h->counts[b] == 0) {
+					continue;
+				}
+				seen += h->counts[b];
+				fprintf (fd, "pianobar_rpc_duration_seconds_bucket{method=\"%s\","
+						"phase=\"%s\",le=\"%g\"} %" PRIu64 "\n", method, phase,
+						BarHistogramUpper (b) / 1e6, seen);
+			}
+			fprintf (fd, "pianobar_rpc_duration_seconds_bucket{method=\"%s\","
+					"phase=\"%s\",le=\"+Inf\"} %" PRIu64 "\n"
+					"pianobar_rpc_duration_seconds_sum{method=\"%s\","
+					"phase=\"%s\"} %g\n"
+					"pianobar_rpc_duration_seconds_count{method=\"%s\","
+					"phase=\"%s\"} %" PRIu64 "\n", method, phase, h->count,
+					method, phase, h->sum / 1e6, method, phase, h->count);
+		}
+	}
+}
+
+#undef writeCounter
+
+/*	write a single unlabeled metric
+ *	@param file
+ *	@param name
+ *	@param type, counter or gauge
+ *	@param help text
+ *	@param value
+ */
+void BarMetricsWriteValue (FILE * const fd, const char * const name,
+		const char * const type, const char * const help, const double value) {
+	fprintf (fd, "# HELP %s %s\n# TYPE %s %s\n%s %g\n", name, help, name,
+			type, name, value);
+}
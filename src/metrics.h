@@ -0,0 +1,93 @@
+/*
+Copyright (c) 2020
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <curl/curl.h>
+
+#include <piano.h>
+
+/* log-linear histogram of µs values, HDR-style: every power of two is split
+ * into BAR_HIST_SUB linear buckets, which bounds the relative error to
+ * 1/BAR_HIST_SUB. Values ≥ 2^32 µs (71 min) are clamped. */
+#define BAR_HIST_SUB_BITS 3
+#define BAR_HIST_SUB (1 << BAR_HIST_SUB_BITS)
+#define BAR_HIST_BUCKETS ((32 - BAR_HIST_SUB_BITS + 1) * BAR_HIST_SUB)
+
+typedef struct {
+	uint32_t counts[BAR_HIST_BUCKETS];
+	uint64_t count, sum, max;
+} BarHistogram_t;
+
+/* phases of a call */
+typedef enum {
+	BAR_MP_DNS = 0,
+	BAR_MP_CONNECT = 1,
+	BAR_MP_TLS = 2,
+	/* request sent until first response byte */
+	BAR_MP_SERVER = 3,
+	/* first until last response byte */
+	BAR_MP_TRANSFER = 4,
+	/* json tokenizer, while downloading */
+	BAR_MP_PARSE = 5,
+	/* PianoResponse */
+	BAR_MP_RESPONSE = 6,
+	/* start to finish of a transfer, including retries */
+	BAR_MP_TOTAL = 7,
+	BAR_MP_COUNT = 8,
+} BarMetricsPhase_t;
+
+typedef struct {
+	BarHistogram_t phases[BAR_MP_COUNT];
+	unsigned long calls, networkErrors, pandoraErrors, retries, reauths;
+	uint64_t bytesOut, bytesIn;
+} BarMethodMetrics_t;
+
+/* per request type, allocated on first use */
+#define BAR_METRICS_TYPES 32
+
+typedef struct {
+	BarMethodMetrics_t *methods[BAR_METRICS_TYPES];
+} BarMetrics_t;
+
+void BarHistogramAdd (BarHistogram_t * const, uint64_t);
+uint64_t BarHistogramPercentile (const BarHistogram_t * const, const double);
+
+void BarMetricsInit (BarMetrics_t * const);
+void BarMetricsDestroy (BarMetrics_t * const);
+void BarMetricsTransfer (BarMetrics_t * const, const PianoRequestType_t,
+		CURL * const, const CURLcode, const long long, const double,
+		const size_t, const size_t, const unsigned int);
+void BarMetricsResponse (BarMetrics_t * const, const PianoRequestType_t,
+		const PianoReturn_t, const double);
+void BarMetricsRetry (BarMetrics_t * const, const PianoRequestType_t);
+void BarMetricsReauth (BarMetrics_t * const, const PianoRequestType_t);
+const char *BarMetricsMethodName (const PianoRequestType_t);
+const char *BarMetricsPhaseName (const BarMetricsPhase_t);
+void BarMetricsWrite (const BarMetrics_t * const, FILE * const);
+void BarMetricsWriteValue (FILE * const, const char * const,
+		const char * const, const char * const, const double);
@@ -41,9 +41,14 @@ THE SOFTWARE.
 #include <fcntl.h>
 #include <limits.h>
 #include <assert.h>
+#include <errno.h>
 #include <inttypes.h>
 #include <arpa/inet.h>
 #include <sys/stat.h>
+#include <time.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include <libavcodec/avcodec.h>
 #include <libavutil/avutil.h>
@@ -58,6 +63,11 @@ THE SOFTWARE.
 #include <libavutil/opt.h>
 #include <libavutil/frame.h>
 
+#include <ao/ao.h>
+#ifdef HAVE_ALSA
+#include <alsa/asoundlib.h>
+#endif
+
 #include "player.h"
 #include "debug.h"
 #include "ui.h"
@@ -65,6 +75,8 @@ THE SOFTWARE.
 
 /* default sample format */
 const enum AVSampleFormat avformat = AV_SAMPLE_FMT_S16;
+/* trailing silence up to this length is trimmed */
+#define SILENCE_HOLD_SECS 10
 
 static void printError (const BarSettings_t * const settings,
 		const char * const msg, int ret) {
@@ -124,18 +136,21 @@ void BarPlayerReset (player_t * const p) {
 	p->streamIdx = -1;
 	p->lastTimestamp = 0;
 	p->interrupted = 0;
-	p->aoDev = NULL;
+	p->output = NULL;
+	p->outputData = NULL;
+	p->nextFgraph = NULL;
+	p->oldFgraph = NULL;
+	p->nextFvolume = NULL;
+	p->nextFabuf = NULL;
+	p->nextFbufsink = NULL;
+	p->oldFbufsink = NULL;
+	p->fabufArgs[0] = '\0';
+	p->fafmtArgs[0] = '\0';
 }
 
-/*	Update volume filter
+/*	Update volume filter, aoplayLock must be held
  */
-void BarPlayerSetVolume (player_t * const player) {
-	assert (player != NULL);
-
-	if (player->mode != PLAYER_PLAYING) {
-		return;
-	}
-
+static void setVolume (player_t * const player) {
 	int ret;
 #ifdef HAVE_AVFILTER_GRAPH_SEND_COMMAND
 	/* ffmpeg and libav disagree on the type of this option (string vs. double)
@@ -159,6 +174,18 @@ void BarPlayerSetVolume (player_t * const player) {
 	}
 }
 
+void BarPlayerSetVolume (player_t * const player) {
+	assert (player != NULL);
+
+	if (player->mode != PLAYER_PLAYING) {
+		return;
+	}
+
+	pthread_mutex_lock (&player->aoplayLock);
+	setVolume (player);
+	pthread_mutex_unlock (&player->aoplayLock);
+}
+
 #define softfail(msg) \
 	printError (player->settings, msg, ret); \
 	return false;
@@ -267,108 +294,791 @@ static int getSampleRate (const player_t * const player) {
 			player->settings->sampleRate;
 }
 
-/*	setup filter chain
+/*	Create filter graph abuffer -> volume -> [user dsp chain ->] aformat ->
+ *	abuffersink. Does not touch player’s state, so it can be called from any
+ *	thread.
  */
-static bool openFilter (player_t * const player) {
-	/* filter setup */
-	char strbuf[256];
+static bool buildFilter (const player_t * const player,
+		const char * const srcArgs, const char * const fmtArgs,
+		const char * const chain, AVFilterGraph ** const retGraph,
+		AVFilterContext ** const retAbuf, AVFilterContext ** const retVolume,
+		AVFilterContext ** const retSink) {
 	int ret = 0;
-	AVCodecParameters * const cp = player->st->codecpar;
+	AVFilterGraph *graph = NULL;
+	AVFilterContext *fabuf = NULL, *fvolume = NULL, *fafmt = NULL,
+			*fbufsink = NULL;
 
-	if ((player->fgraph = avfilter_graph_alloc ()) == NULL) {
+	if ((graph = avfilter_graph_alloc ()) == NULL) {
 		softfail ("graph_alloc");
 	}
 
-	/* abuffer */
-	AVRational time_base = player->st->time_base;
+#define softfailFree(msg) \
+	avfilter_graph_free (&graph); \
+	softfail (msg);
 
-	snprintf (strbuf, sizeof (strbuf),
-			"time_base=%d/%d:sample_rate=%d:sample_fmt=%s:channel_layout=0x%"PRIx64, 
-			time_base.num, time_base.den, cp->sample_rate,
-			av_get_sample_fmt_name (player->cctx->sample_fmt),
-			cp->channel_layout);
-	if ((ret = avfilter_graph_create_filter (&player->fabuf,
-			avfilter_get_by_name ("abuffer"), "source", strbuf, NULL,
-			player->fgraph)) < 0) {
-		softfail ("create_filter abuffer");
+	/* abuffer */
+	if ((ret = avfilter_graph_create_filter (&fabuf,
+			avfilter_get_by_name ("abuffer"), "source", srcArgs, NULL,
+			graph)) < 0) {
+		softfailFree ("create_filter abuffer");
 	}
 
 	/* volume */
-	if ((ret = avfilter_graph_create_filter (&player->fvolume,
+	if ((ret = avfilter_graph_create_filter (&fvolume,
 			avfilter_get_by_name ("volume"), "volume", "0dB", NULL,
-			player->fgraph)) < 0) {
-		softfail ("create_filter volume");
+			graph)) < 0) {
+		softfailFree ("create_filter volume");
 	}
 
 	/* aformat: convert float samples into something more usable */
-	AVFilterContext *fafmt = NULL;
-	snprintf (strbuf, sizeof (strbuf), "sample_fmts=%s:sample_rates=%d",
-			av_get_sample_fmt_name (avformat), getSampleRate (player));
 	if ((ret = avfilter_graph_create_filter (&fafmt,
-					avfilter_get_by_name ("aformat"), "format", strbuf, NULL,
-					player->fgraph)) < 0) {
-		softfail ("create_filter aformat");
+					avfilter_get_by_name ("aformat"), "format", fmtArgs, NULL,
+					graph)) < 0) {
+		softfailFree ("create_filter aformat");
 	}
 
 	/* abuffersink */
-	if ((ret = avfilter_graph_create_filter (&player->fbufsink,
+	if ((ret = avfilter_graph_create_filter (&fbufsink,
 			avfilter_get_by_name ("abuffersink"), "sink", NULL, NULL,
-			player->fgraph)) < 0) {
-		softfail ("create_filter abuffersink");
+			graph)) < 0) {
+		softfailFree ("create_filter abuffersink");
+	}
+
+	if (avfilter_link (fabuf, 0, fvolume, 0) != 0 ||
+			avfilter_link (fafmt, 0, fbufsink, 0) != 0) {
+		ret = AVERROR (EINVAL);
+		softfailFree ("filter_link");
 	}
 
-	/* connect filter: abuffer -> volume -> aformat -> abuffersink */
-	if (avfilter_link (player->fabuf, 0, player->fvolume, 0) != 0 ||
-			avfilter_link (player->fvolume, 0, fafmt, 0) != 0 ||
-			avfilter_link (fafmt, 0, player->fbufsink, 0) != 0) {
-		softfail ("filter_link");
+	if (chain != NULL && chain[0] != '\0') {
+		/* user filters, unlabeled input/output are connected to volume and
+		 * aformat */
+		AVFilterInOut *outputs = avfilter_inout_alloc (),
+				*inputs = avfilter_inout_alloc ();
+		assert (outputs != NULL && inputs != NULL);
+		outputs->name = av_strdup ("in");
+		outputs->filter_ctx = fvolume;
+		outputs->pad_idx = 0;
+		outputs->next = NULL;
+		inputs->name = av_strdup ("out");
+		inputs->filter_ctx = fafmt;
+		inputs->pad_idx = 0;
+		inputs->next = NULL;
+		ret = avfilter_graph_parse_ptr (graph, chain, &inputs, &outputs, NULL);
+		avfilter_inout_free (&inputs);
+		avfilter_inout_free (&outputs);
+		if (ret < 0) {
+			softfailFree ("Invalid audio filters");
+		}
+	} else if (avfilter_link (fvolume, 0, fafmt, 0) != 0) {
+		ret = AVERROR (EINVAL);
+		softfailFree ("filter_link");
 	}
 
-	if ((ret = avfilter_graph_config (player->fgraph, NULL)) < 0) {
-		softfail ("graph_config");
+	if ((ret = avfilter_graph_config (graph, NULL)) < 0) {
+		softfailFree ("graph_config");
 	}
 
+#undef softfailFree
+
+	*retGraph = graph;
+	*retAbuf = fabuf;
+	*retVolume = fvolume;
+	*retSink = fbufsink;
+
 	return true;
 }
 
-/*	setup libao
+/*	setup filter chain
  */
-static bool openDevice (player_t * const player) {
-	const AVCodecParameters * const cp = player->st->codecpar;
+static bool openFilter (player_t * const player) {
+	AVCodecParameters * const cp = player->st->codecpar;
+
+	/* abuffer */
+	AVRational time_base = player->st->time_base;
+	const uint64_t channelLayout = cp->channel_layout != 0 ?
+			cp->channel_layout :
+			(uint64_t) av_get_default_channel_layout (cp->channels);
+
+	char srcArgs[sizeof (player->fabufArgs)],
+			fmtArgs[sizeof (player->fafmtArgs)];
+	snprintf (srcArgs, sizeof (srcArgs),
+			"time_base=%d/%d:sample_rate=%d:sample_fmt=%s:channel_layout=0x%"PRIx64, 
+			time_base.num, time_base.den, cp->sample_rate,
+			av_get_sample_fmt_name (player->cctx->sample_fmt),
+			channelLayout);
+	/* user filters must not change the output format */
+	snprintf (fmtArgs, sizeof (fmtArgs),
+			"sample_fmts=%s:sample_rates=%d:channel_layouts=0x%"PRIx64,
+			av_get_sample_fmt_name (avformat), getSampleRate (player),
+			channelLayout);
+
+	pthread_mutex_lock (&player->lock);
+	char * const chain = player->settings->dspChain == NULL ? NULL :
+			strdup (player->settings->dspChain);
+	pthread_mutex_unlock (&player->lock);
+
+	AVFilterGraph *fgraph = NULL;
+	AVFilterContext *fabuf = NULL, *fvolume = NULL, *fbufsink = NULL;
+	bool ret = buildFilter (player, srcArgs, fmtArgs, chain, &fgraph, &fabuf,
+			&fvolume, &fbufsink);
+	if (!ret && chain != NULL) {
+		/* do not stop playback because of a broken dsp chain */
+		BarUiMsg (player->settings, MSG_ERR, "Playing without audio filters.\n");
+		ret = buildFilter (player, srcArgs, fmtArgs, NULL, &fgraph, &fabuf,
+				&fvolume, &fbufsink);
+	}
+	free (chain);
+	if (!ret) {
+		return false;
+	}
+
+	pthread_mutex_lock (&player->aoplayLock);
+	player->fgraph = fgraph;
+	player->fabuf = fabuf;
+	player->fvolume = fvolume;
+	player->fbufsink = fbufsink;
+	memcpy (player->fabufArgs, srcArgs, sizeof (srcArgs));
+	memcpy (player->fafmtArgs, fmtArgs, sizeof (fmtArgs));
+	pthread_mutex_unlock (&player->aoplayLock);
+
+	return true;
+}
+
+/*	Replace user dsp chain of the currently playing song. The new graph is
+ *	built here and swapped in by the decoder between two frames. Returns false
+ *	if the chain is invalid.
+ */
+bool BarPlayerSetDspChain (player_t * const player, const char * const chain) {
+	assert (player != NULL);
+
+	char srcArgs[sizeof (player->fabufArgs)],
+			fmtArgs[sizeof (player->fafmtArgs)];
+	pthread_mutex_lock (&player->aoplayLock);
+	const bool active = player->fgraph != NULL;
+	memcpy (srcArgs, player->fabufArgs, sizeof (srcArgs));
+	memcpy (fmtArgs, player->fafmtArgs, sizeof (fmtArgs));
+	pthread_mutex_unlock (&player->aoplayLock);
+
+	if (!active) {
+		/* nothing playing, validate against a typical stream. The chain is
+		 * used for the next song. */
+		const int sampleRate = player->settings->sampleRate == 0 ? 44100 :
+				player->settings->sampleRate;
+		snprintf (srcArgs, sizeof (srcArgs),
+				"time_base=1/44100:sample_rate=44100:sample_fmt=%s:"
+				"channel_layout=0x%"PRIx64,
+				av_get_sample_fmt_name (AV_SAMPLE_FMT_FLTP),
+				(uint64_t) AV_CH_LAYOUT_STEREO);
+		snprintf (fmtArgs, sizeof (fmtArgs),
+				"sample_fmts=%s:sample_rates=%d:channel_layouts=0x%"PRIx64,
+				av_get_sample_fmt_name (avformat), sampleRate,
+				(uint64_t) AV_CH_LAYOUT_STEREO);
+	}
+
+	AVFilterGraph *fgraph = NULL;
+	AVFilterContext *fabuf = NULL, *fvolume = NULL, *fbufsink = NULL;
+	if (!buildFilter (player, srcArgs, fmtArgs, chain, &fgraph, &fabuf,
+			&fvolume, &fbufsink)) {
+		return false;
+	}
+
+	if (!active) {
+		avfilter_graph_free (&fgraph);
+		return true;
+	}
+
+	pthread_mutex_lock (&player->aoplayLock);
+	if (player->fgraph != NULL && strcmp (srcArgs, player->fabufArgs) == 0 &&
+			strcmp (fmtArgs, player->fafmtArgs) == 0) {
+		/* replace pending graph, if the decoder did not pick it up yet */
+		avfilter_graph_free (&player->nextFgraph);
+		player->nextFgraph = fgraph;
+		player->nextFabuf = fabuf;
+		player->nextFvolume = fvolume;
+		player->nextFbufsink = fbufsink;
+	} else {
+		/* song changed in the meantime */
+		avfilter_graph_free (&fgraph);
+	}
+	pthread_mutex_unlock (&player->aoplayLock);
 
+	return true;
+}
+
+/*	Install pending filter graph, aoplayLock must be held. The old graph is
+ *	flushed and drained by the ao thread, so no buffered audio is lost.
+ */
+static void swapFilter (player_t * const player) {
+	assert (player->nextFgraph != NULL);
+	assert (player->oldFgraph == NULL);
+
+	const int ret = av_buffersrc_add_frame (player->fabuf, NULL);
+	assert (ret == 0);
+	player->oldFgraph = player->fgraph;
+	player->oldFbufsink = player->fbufsink;
+
+	player->fgraph = player->nextFgraph;
+	player->fabuf = player->nextFabuf;
+	player->fvolume = player->nextFvolume;
+	player->fbufsink = player->nextFbufsink;
+	player->nextFgraph = NULL;
+	player->nextFabuf = NULL;
+	player->nextFvolume = NULL;
+	player->nextFbufsink = NULL;
+
+	setVolume (player);
+	debugPrint (DEBUG_AUDIO, "decoder swapped filter graph\n");
+}
+
+/*	Audio output backends. open() allocates player->outputData, write() is
+ *	called by the ao thread only, drain() waits until all written data has
+ *	been played at the end of a song and latency() returns the amount of
+ *	audio (in seconds) written but not played yet.
+ */
+typedef struct {
+	unsigned int channels, rate, bits;
+} outputFormat;
+
+typedef struct BarPlayerOutput {
+	const char *name;
+	bool (*open) (player_t * const, const outputFormat * const);
+	bool (*write) (player_t * const, const char * const, const size_t);
+	void (*drain) (player_t * const);
+	void (*close) (player_t * const);
+	double (*latency) (player_t * const);
+} BarPlayerOutput_t;
+
+static void outputNoDrain (player_t * const player) {
+}
+
+static double outputNoLatency (player_t * const player) {
+	return 0;
+}
+
+/*	libao, using the driver from libao’s configuration
+ */
+static bool aoOpen (player_t * const player, const outputFormat * const fmt) {
 	ao_sample_format aoFmt;
 	memset (&aoFmt, 0, sizeof (aoFmt));
-	aoFmt.bits = av_get_bytes_per_sample (avformat) * 8;
-	assert (aoFmt.bits > 0);
-	aoFmt.channels = cp->channels;
-	aoFmt.rate = getSampleRate (player);
+	aoFmt.bits = fmt->bits;
+	aoFmt.channels = fmt->channels;
+	aoFmt.rate = fmt->rate;
 	aoFmt.byte_format = AO_FMT_NATIVE;
 
-	int driver = -1;
-	if (player->settings->audioPipe) {
-		// using audio pipe
-		struct stat st;
-		if (stat (player->settings->audioPipe, &st)) {
-			BarUiMsg (player->settings, MSG_ERR, "Cannot stat audio pipe file.\n");
+	const int driver = ao_default_driver_id ();
+	if ((player->outputData = ao_open_live (driver, &aoFmt, NULL)) == NULL) {
+		BarUiMsg (player->settings, MSG_ERR, "Cannot open audio device.\n");
+		return false;
+	}
+	return true;
+}
+
+static bool aoWrite (player_t * const player, const char * const data,
+		const size_t size) {
+	return ao_play (player->outputData, (char *) data, size) != 0;
+}
+
+static void aoClose (player_t * const player) {
+	ao_close (player->outputData);
+}
+
+/*	raw samples written to audio_pipe
+ */
+static bool pipeOpen (player_t * const player, const outputFormat * const fmt) {
+	const char * const path = player->settings->audioPipe;
+	if (path == NULL) {
+		BarUiMsg (player->settings, MSG_ERR, "No audio pipe configured.\n");
+		return false;
+	}
+
+	struct stat st;
+	if (stat (path, &st)) {
+		BarUiMsg (player->settings, MSG_ERR, "Cannot stat audio pipe file.\n");
+		return false;
+	}
+	if (!S_ISFIFO (st.st_mode)) {
+		BarUiMsg (player->settings, MSG_ERR, "File is not a pipe, error.\n");
+		return false;
+	}
+
+	int * const fd = malloc (sizeof (*fd));
+	assert (fd != NULL);
+	/* blocks until a reader is connected */
+	if ((*fd = open (path, O_WRONLY)) == -1) {
+		BarUiMsg (player->settings, MSG_ERR, "Cannot open audio pipe file.\n");
+		free (fd);
+		return false;
+	}
+	player->outputData = fd;
+	return true;
+}
+
+static bool pipeWrite (player_t * const player, const char * const data,
+		const size_t size) {
+	const int * const fd = player->outputData;
+	size_t written = 0;
+	while (written < size) {
+		const ssize_t ret = write (*fd, data + written, size - written);
+		if (ret == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
 			return false;
 		}
-		if (!S_ISFIFO (st.st_mode)) {
-			BarUiMsg (player->settings, MSG_ERR, "File is not a pipe, error.\n");
-			return false;
+		written += ret;
+	}
+	return true;
+}
+
+static void pipeClose (player_t * const player) {
+	int * const fd = player->outputData;
+	close (*fd);
+	free (fd);
+}
+
+/*	discard samples, either at playback speed or as fast as possible
+ */
+typedef struct {
+	struct timespec start;
+	uint64_t frames;
+	unsigned int rate, frameSize;
+	bool realtime;
+} nullOutput;
+
+static bool nullOpenCommon (player_t * const player,
+		const outputFormat * const fmt, const bool realtime) {
+	nullOutput * const out = calloc (1, sizeof (*out));
+	assert (out != NULL);
+	out->rate = fmt->rate;
+	out->frameSize = fmt->channels * fmt->bits / 8;
+	out->realtime = realtime;
+	clock_gettime (CLOCK_MONOTONIC, &out->start);
+	player->outputData = out;
+	return true;
+}
+
+static bool nullOpen (player_t * const player, const outputFormat * const fmt) {
+	return nullOpenCommon (player, fmt, true);
+}
+
+static bool nullFastOpen (player_t * const player,
+		const outputFormat * const fmt) {
+	return nullOpenCommon (player, fmt, false);
+}
+
+static double timespecDiff (const struct timespec * const a,
+		const struct timespec * const b) {
+	return (double) (a->tv_sec - b->tv_sec) +
+			(double) (a->tv_nsec - b->tv_nsec) / 1e9;
+}
+
+static bool nullWrite (player_t * const player, const char * const data,
+		const size_t size) {
+	nullOutput * const out = player->outputData;
+	if (!out->realtime) {
+		return true;
+	}
+
+	struct timespec now;
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	const double elapsed = timespecDiff (&now, &out->start),
+			queued = (double) out->frames / out->rate;
+	if (elapsed > queued + 0.5) {
+		/* we fell behind (paused?), restart the clock */
+		out->start = now;
+		out->frames = 0;
+	}
+	out->frames += size / out->frameSize;
+
+	/* sleep until the previous block is “played” */
+	const double ahead = queued - elapsed;
+	if (ahead > 0) {
+		struct timespec sleep;
+		sleep.tv_sec = ahead;
+		sleep.tv_nsec = (ahead - sleep.tv_sec) * 1e9;
+		while (nanosleep (&sleep, &sleep) == -1 && errno == EINTR);
+	}
+	return true;
+}
+
+static double nullLatency (player_t * const player) {
+	nullOutput * const out = player->outputData;
+	if (!out->realtime) {
+		return 0;
+	}
+
+	struct timespec now;
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	const double ahead = (double) out->frames / out->rate -
+			timespecDiff (&now, &out->start);
+	return ahead > 0 ? ahead : 0;
+}
+
+static void nullClose (player_t * const player) {
+	free (player->outputData);
+}
+
+/*	RIFF WAVE file writer. audio_file may contain %n, which is replaced by a
+ *	track counter.
+ */
+typedef struct {
+	FILE *fp;
+	char *path;
+	uint32_t dataSize;
+	/* size fields are 32 bit, samples beyond that are dropped */
+	bool full;
+} wavOutput;
+
+/* largest data chunk the RIFF size field can describe */
+#define WAV_MAX_DATA (UINT32_MAX - 36)
+
+static void wavPutLe (uint8_t * const dest, const uint32_t val,
+		const size_t bytes) {
+	for (size_t i = 0; i < bytes; i++) {
+		dest[i] = (val >> (i*8)) & 0xff;
+	}
+}
+
+static bool wavOpen (player_t * const player, const outputFormat * const fmt) {
+	static unsigned int track = 0;
+
+	if (player->settings->audioFile == NULL) {
+		BarUiMsg (player->settings, MSG_ERR, "No audio file configured.\n");
+		return false;
+	}
+
+	char trackStr[16], path[PATH_MAX];
+	snprintf (trackStr, sizeof (trackStr), "%u", track++);
+	const char *vals[] = {trackStr};
+	BarUiCustomFormat (path, sizeof (path), player->settings->audioFile, "n",
+			vals);
+
+	wavOutput * const out = calloc (1, sizeof (*out));
+	assert (out != NULL);
+	if ((out->fp = fopen (path, "wb")) == NULL) {
+		BarUiMsg (player->settings, MSG_ERR, "Cannot open audio file %s.\n",
+				path);
+		free (out);
+		return false;
+	}
+	out->path = strdup (path);
+	assert (out->path != NULL);
+
+	/* sizes are fixed up on close */
+	const unsigned int blockAlign = fmt->channels * fmt->bits / 8;
+	uint8_t header[44];
+	memcpy (&header[0], "RIFF", 4);
+	wavPutLe (&header[4], 36, 4);
+	memcpy (&header[8], "WAVEfmt ", 8);
+	wavPutLe (&header[16], 16, 4);
+	wavPutLe (&header[20], 1, 2); /* PCM */
+	wavPutLe (&header[22], fmt->channels, 2);
+	wavPutLe (&header[24], fmt->rate, 4);
+	wavPutLe (&header[28], fmt->rate * blockAlign, 4);
+	wavPutLe (&header[32], blockAlign, 2);
+	wavPutLe (&header[34], fmt->bits, 2);
+	memcpy (&header[36], "data", 4);
+	wavPutLe (&header[40], 0, 4);
+	if (fwrite (header, sizeof (header), 1, out->fp) != 1) {
+		BarUiMsg (player->settings, MSG_ERR, "Cannot write audio file.\n");
+		fclose (out->fp);
+		free (out->path);
+		free (out);
+		return false;
+	}
+
+	player->outputData = out;
+	return true;
+}
+
+static bool wavWrite (player_t * const player, const char * const data,
+		const size_t size) {
+	wavOutput * const out = player->outputData;
+	if (size > WAV_MAX_DATA - out->dataSize) {
+		if (!out->full) {
+			BarUiMsg (player->settings, MSG_ERR, "Audio file %s is full, "
+					"dropping the rest of the song.\n", out->path);
+			out->full = true;
 		}
-		driver = ao_driver_id ("raw");
-		if ((player->aoDev = ao_open_file(driver, player->settings->audioPipe, 1, &aoFmt, NULL)) == NULL) {
-			BarUiMsg (player->settings, MSG_ERR, "Cannot open audio pipe file.\n");
+		return false;
+	}
+	/* samples are native endian, WAV is little endian */
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	for (size_t i = 0; i + 1 < size; i += 2) {
+		if (fputc (data[i+1], out->fp) == EOF ||
+				fputc (data[i], out->fp) == EOF) {
 			return false;
 		}
-	} else {
-		// use driver from libao configuration
-		driver = ao_default_driver_id ();
-		if ((player->aoDev = ao_open_live (driver, &aoFmt, NULL)) == NULL) {
-			BarUiMsg (player->settings, MSG_ERR, "Cannot open audio device.\n");
-			return false;
+	}
+#else
+	if (fwrite (data, 1, size, out->fp) != size) {
+		return false;
+	}
+#endif
+	out->dataSize += size;
+	return true;
+}
+
+/*	patch the header’s 32 bit size field at offset
+ */
+static bool wavPatchSize (FILE * const fp, const long offset,
+		const uint32_t val) {
+	uint8_t size[4];
+	wavPutLe (size, val, sizeof (size));
+	return fseek (fp, offset, SEEK_SET) == 0 &&
+			fwrite (size, sizeof (size), 1, fp) == 1;
+}
+
+static void wavClose (player_t * const player) {
+	wavOutput * const out = player->outputData;
+
+	/* wavWrite keeps dataSize within WAV_MAX_DATA */
+	bool ok = wavPatchSize (out->fp, 4, 36 + out->dataSize) &&
+			wavPatchSize (out->fp, 40, out->dataSize);
+	int err = errno;
+	if (fclose (out->fp) != 0 && ok) {
+		ok = false;
+		err = errno;
+	}
+	if (!ok) {
+		BarUiMsg (player->settings, MSG_ERR, "Cannot finish audio file %s: "
+				"%s\n", out->path, strerror (err));
+	}
+
+	free (out->path);
+	free (out);
+}
+
+#ifdef HAVE_ALSA
+/*	Direct ALSA output. Samples are copied straight into the mmap’ed ring
+ *	buffer, period and buffer time are configurable to keep latency low.
+ */
+typedef struct {
+	snd_pcm_t *pcm;
+	snd_pcm_uframes_t periodSize;
+	unsigned int rate, frameSize;
+} alsaOutput;
+
+#define alsaCheck(call, msg) \
+	if ((err = (call)) < 0) { \
+		BarUiMsg (player->settings, MSG_ERR, "%s (%s)\n", msg, \
+				snd_strerror (err)); \
+		goto error; \
+	}
+
+static bool alsaOpen (player_t * const player, const outputFormat * const fmt) {
+	int err;
+	snd_pcm_hw_params_t *hw = NULL;
+	snd_pcm_sw_params_t *sw = NULL;
+
+	assert (fmt->bits == 16);
+
+	alsaOutput * const out = calloc (1, sizeof (*out));
+	assert (out != NULL);
+	out->rate = fmt->rate;
+	out->frameSize = fmt->channels * fmt->bits / 8;
+
+	alsaCheck (snd_pcm_open (&out->pcm, player->settings->alsaDevice,
+			SND_PCM_STREAM_PLAYBACK, 0), "Cannot open audio device");
+
+	unsigned int rate = fmt->rate,
+			bufferTime = player->settings->alsaBufferTime * 1000,
+			periodTime = player->settings->alsaPeriodTime * 1000;
+	snd_pcm_uframes_t bufferSize;
+	alsaCheck (snd_pcm_hw_params_malloc (&hw), "snd_pcm_hw_params_malloc");
+	alsaCheck (snd_pcm_hw_params_any (out->pcm, hw), "snd_pcm_hw_params_any");
+	alsaCheck (snd_pcm_hw_params_set_access (out->pcm, hw,
+			SND_PCM_ACCESS_MMAP_INTERLEAVED), "Cannot use mmap access");
+	alsaCheck (snd_pcm_hw_params_set_format (out->pcm, hw,
+			SND_PCM_FORMAT_S16), "Cannot set sample format");
+	alsaCheck (snd_pcm_hw_params_set_channels (out->pcm, hw, fmt->channels),
+			"Cannot set channel count");
+	alsaCheck (snd_pcm_hw_params_set_rate_near (out->pcm, hw, &rate, NULL),
+			"Cannot set sample rate");
+	if (rate != fmt->rate) {
+		BarUiMsg (player->settings, MSG_ERR, "Sample rate %u not supported, "
+				"set sample_rate.\n", fmt->rate);
+		goto error;
+	}
+	alsaCheck (snd_pcm_hw_params_set_buffer_time_near (out->pcm, hw,
+			&bufferTime, NULL), "Cannot set buffer time");
+	alsaCheck (snd_pcm_hw_params_set_period_time_near (out->pcm, hw,
+			&periodTime, NULL), "Cannot set period time");
+	alsaCheck (snd_pcm_hw_params (out->pcm, hw), "Cannot set hw parameters");
+	alsaCheck (snd_pcm_hw_params_get_period_size (hw, &out->periodSize, NULL),
+			"snd_pcm_hw_params_get_period_size");
+	alsaCheck (snd_pcm_hw_params_get_buffer_size (hw, &bufferSize),
+			"snd_pcm_hw_params_get_buffer_size");
+
+	/* start as soon as one period is queued, wake up for every period */
+	alsaCheck (snd_pcm_sw_params_malloc (&sw), "snd_pcm_sw_params_malloc");
+	alsaCheck (snd_pcm_sw_params_current (out->pcm, sw),
+			"snd_pcm_sw_params_current");
+	alsaCheck (snd_pcm_sw_params_set_start_threshold (out->pcm, sw,
+			out->periodSize), "Cannot set start threshold");
+	alsaCheck (snd_pcm_sw_params_set_avail_min (out->pcm, sw, out->periodSize),
+			"Cannot set avail_min");
+	alsaCheck (snd_pcm_sw_params (out->pcm, sw), "Cannot set sw parameters");
+	alsaCheck (snd_pcm_prepare (out->pcm), "snd_pcm_prepare");
+
+	debugPrint (DEBUG_AUDIO, "alsa: buffer %lu frames, period %lu frames\n",
+			(unsigned long) bufferSize, (unsigned long) out->periodSize);
+
+	snd_pcm_hw_params_free (hw);
+	snd_pcm_sw_params_free (sw);
+	player->outputData = out;
+	return true;
+
+error:
+	if (hw != NULL) {
+		snd_pcm_hw_params_free (hw);
+	}
+	if (sw != NULL) {
+		snd_pcm_sw_params_free (sw);
+	}
+	if (out->pcm != NULL) {
+		snd_pcm_close (out->pcm);
+	}
+	free (out);
+	return false;
+}
+
+#undef alsaCheck
+
+/*	recover from underrun (i.e. after pausing) or suspend
+ */
+static bool alsaRecover (player_t * const player, const int err) {
+	alsaOutput * const out = player->outputData;
+	debugPrint (DEBUG_AUDIO, "alsa: recovering from %s\n", snd_strerror (err));
+	return snd_pcm_recover (out->pcm, err, 1) == 0;
+}
+
+static bool alsaWrite (player_t * const player, const char *data,
+		const size_t size) {
+	alsaOutput * const out = player->outputData;
+	snd_pcm_uframes_t frames = size / out->frameSize;
+
+	while (frames > 0) {
+		const snd_pcm_sframes_t avail = snd_pcm_avail_update (out->pcm);
+		if (avail < 0) {
+			if (!alsaRecover (player, avail)) {
+				return false;
+			}
+			continue;
+		}
+		if ((snd_pcm_uframes_t) avail < frames &&
+				(snd_pcm_uframes_t) avail < out->periodSize) {
+			/* buffer full, wait for next period */
+			if (snd_pcm_state (out->pcm) == SND_PCM_STATE_PREPARED) {
+				snd_pcm_start (out->pcm);
+			}
+			const int err = snd_pcm_wait (out->pcm, 1000);
+			if (err < 0 && !alsaRecover (player, err)) {
+				return false;
+			}
+			continue;
+		}
+
+		const snd_pcm_channel_area_t *areas;
+		snd_pcm_uframes_t offset, n = frames;
+		int err;
+		if ((err = snd_pcm_mmap_begin (out->pcm, &areas, &offset, &n)) < 0) {
+			if (!alsaRecover (player, err)) {
+				return false;
+			}
+			continue;
+		}
+		/* interleaved: all channels share one area */
+		char * const dest = (char *) areas[0].addr + areas[0].first / 8 +
+				offset * areas[0].step / 8;
+		memcpy (dest, data, n * out->frameSize);
+		const snd_pcm_sframes_t committed = snd_pcm_mmap_commit (out->pcm,
+				offset, n);
+		if (committed < 0 || (snd_pcm_uframes_t) committed != n) {
+			if (!alsaRecover (player, committed >= 0 ? -EPIPE : committed)) {
+				return false;
+			}
+			continue;
+		}
+		data += n * out->frameSize;
+		frames -= n;
+	}
+
+	return true;
+}
+
+static void alsaDrain (player_t * const player) {
+	alsaOutput * const out = player->outputData;
+	/* song shorter than the start threshold */
+	if (snd_pcm_state (out->pcm) == SND_PCM_STATE_PREPARED) {
+		snd_pcm_start (out->pcm);
+	}
+	snd_pcm_drain (out->pcm);
+}
+
+static double alsaLatency (player_t * const player) {
+	alsaOutput * const out = player->outputData;
+	snd_pcm_sframes_t delay;
+	if (snd_pcm_delay (out->pcm, &delay) < 0 || delay < 0) {
+		return 0;
+	}
+	return (double) delay / out->rate;
+}
+
+static void alsaClose (player_t * const player) {
+	alsaOutput * const out = player->outputData;
+	/* drops pending frames if the song was skipped */
+	snd_pcm_close (out->pcm);
+	free (out);
+}
+#endif
+
+static const BarPlayerOutput_t outputs[] = {
+	{"ao", aoOpen, aoWrite, outputNoDrain, aoClose, outputNoLatency},
+	{"pipe", pipeOpen, pipeWrite, outputNoDrain, pipeClose, outputNoLatency},
+	{"null", nullOpen, nullWrite, outputNoDrain, nullClose, nullLatency},
+	{"null_fast", nullFastOpen, nullWrite, outputNoDrain, nullClose,
+			outputNoLatency},
+	{"wav", wavOpen, wavWrite, outputNoDrain, wavClose, outputNoLatency},
+#ifdef HAVE_ALSA
+	{"alsa", alsaOpen, alsaWrite, alsaDrain, alsaClose, alsaLatency},
+#endif
+};
+
+/*	setup audio output
+ */
+static bool openDevice (player_t * const player) {
+	const AVCodecParameters * const cp = player->st->codecpar;
+
+	outputFormat fmt;
+	fmt.bits = av_get_bytes_per_sample (avformat) * 8;
+	assert (fmt.bits > 0);
+	fmt.channels = cp->channels;
+	fmt.rate = getSampleRate (player);
+
+	/* audio_pipe implies the pipe backend */
+	const char *name = player->settings->audioOutput;
+	if (name == NULL) {
+		name = player->settings->audioPipe != NULL ? "pipe" : "ao";
+	}
+
+	const BarPlayerOutput_t *output = NULL;
+	for (size_t i = 0; i < sizeof (outputs) / sizeof (*outputs); i++) {
+		if (strcmp (outputs[i].name, name) == 0) {
+			output = &outputs[i];
+			break;
 		}
 	}
+	if (output == NULL) {
+		BarUiMsg (player->settings, MSG_ERR, "Unknown audio output %s.\n", name);
+		return false;
+	}
+
+	if (!output->open (player, &fmt)) {
+		return false;
+	}
+	player->output = output;
 
 	return true;
 }
@@ -468,6 +1178,10 @@ static int play (player_t * const player) {
 				frame->pts = 0;
 			}
 			pthread_mutex_lock (&player->aoplayLock);
+			if (player->nextFgraph != NULL && player->oldFgraph == NULL) {
+				swapFilter (player);
+				pthread_cond_broadcast (&player->aoplayCond);
+			}
 			ret = av_buffersrc_write_frame (player->fabuf, frame);
 			assert (ret >= 0);
 			pthread_mutex_unlock (&player->aoplayLock);
@@ -500,12 +1214,20 @@ static int play (player_t * const player) {
 }
 
 static void finish (player_t * const player) {
-	ao_close (player->aoDev);
-	player->aoDev = NULL;
+	if (player->output != NULL) {
+		player->output->close (player);
+		player->output = NULL;
+		player->outputData = NULL;
+	}
+	pthread_mutex_lock (&player->aoplayLock);
 	if (player->fgraph != NULL) {
 		avfilter_graph_free (&player->fgraph);
 		player->fgraph = NULL;
 	}
+	avfilter_graph_free (&player->nextFgraph);
+	avfilter_graph_free (&player->oldFgraph);
+	player->oldFbufsink = NULL;
+	pthread_mutex_unlock (&player->aoplayLock);
 	if (player->cctx != NULL) {
 		avcodec_close (player->cctx);
 		player->cctx = NULL;
@@ -551,6 +1273,91 @@ void *BarPlayerThread (void *data) {
 	return (void *) pret;
 }
 
+/*	Largest absolute sample value of interleaved S16 samples
+ */
+static int peakS16 (const int16_t * const samples, const size_t count) {
+	size_t i = 0;
+	int peak = 0;
+#ifdef __SSE2__
+	/* |x| as max (x, 0-x), saturating, so -32768 does not overflow */
+	const __m128i zero = _mm_setzero_si128 ();
+	__m128i vpeak = zero;
+	for (; i + 8 <= count; i += 8) {
+		const __m128i v = _mm_loadu_si128 ((const __m128i *) &samples[i]);
+		vpeak = _mm_max_epi16 (vpeak, _mm_max_epi16 (v, _mm_subs_epi16 (zero, v)));
+	}
+	int16_t lanes[8];
+	_mm_storeu_si128 ((__m128i *) lanes, vpeak);
+	for (size_t k = 0; k < 8; k++) {
+		peak = lanes[k] > peak ? lanes[k] : peak;
+	}
+#endif
+	for (; i < count; i++) {
+		const int v = samples[i];
+		const int a = v < 0 ? -v : v;
+		peak = a > peak ? a : peak;
+	}
+	return peak;
+}
+
+/*	Silent frames held back at the end of a track. If the track ends while
+ *	they are still queued they are dropped, otherwise they are played.
+ */
+typedef struct {
+	AVFrame **frames;
+	size_t start, count, size;
+	int64_t samples;
+} silenceQueue;
+
+static void silenceQueuePush (silenceQueue * const q, AVFrame * const frame) {
+	if (q->start + q->count == q->size) {
+		if (q->start > 0) {
+			memmove (q->frames, &q->frames[q->start],
+					q->count * sizeof (*q->frames));
+			q->start = 0;
+		} else {
+			q->size = q->size == 0 ? 64 : q->size * 2;
+			q->frames = realloc (q->frames, q->size * sizeof (*q->frames));
+			assert (q->frames != NULL);
+		}
+	}
+	q->frames[q->start + q->count] = frame;
+	++q->count;
+	q->samples += frame->nb_samples;
+}
+
+static AVFrame *silenceQueuePop (silenceQueue * const q) {
+	if (q->count == 0) {
+		return NULL;
+	}
+	AVFrame * const frame = q->frames[q->start];
+	++q->start;
+	--q->count;
+	q->samples -= frame->nb_samples;
+	return frame;
+}
+
+/*	hand frame over to audio output and update play time
+ */
+static void aoPlayFrame (player_t * const player, const AVFrame * const frame,
+		const double timeBase) {
+	const int numChannels = av_get_channel_layout_nb_channels (
+			frame->channel_layout);
+	const int bps = av_get_bytes_per_sample (frame->format);
+	if (!player->output->write (player, (const char *) frame->data[0],
+			frame->nb_samples * numChannels * bps)) {
+		debugPrint (DEBUG_AUDIO, "audio output %s failed to write frame\n",
+				player->output->name);
+	}
+
+	/* the frame is not audible until the output’s buffer is played */
+	const double played = (double) frame->pts * timeBase -
+			player->output->latency (player);
+	pthread_mutex_lock (&player->lock);
+	player->songPlayed = played > 0 ? played : 0;
+	pthread_mutex_unlock (&player->lock);
+}
+
 void *BarAoPlayThread (void *data) {
 	assert (data != NULL);
 
@@ -561,15 +1368,38 @@ void *BarAoPlayThread (void *data) {
 	assert (filteredFrame != NULL);
 
 	int ret;
-	const double timeBase = av_q2d (av_buffersink_get_time_base (player->fbufsink)),
-			timeBaseSt = av_q2d (player->st->time_base);
+	const double timeBaseSt = av_q2d (player->st->time_base);
+
+	/* silence trimming: skip everything below threshold until the first
+	 * audible frame, then hold back silent stretches until we know whether
+	 * the track ends with them. */
+	const bool trimSilence = player->settings->trimSilence;
+	const int silenceThreshold = INT16_MAX *
+			pow (10, player->settings->silenceThreshold / 20.0);
+	const int64_t maxHeldSamples = (int64_t) SILENCE_HOLD_SECS *
+			av_buffersink_get_sample_rate (player->fbufsink);
+	bool audible = false, eof = false;
+	double timeBase = av_q2d (av_buffersink_get_time_base (player->fbufsink));
+	silenceQueue held = {NULL, 0, 0, 0, 0};
+	int64_t lastPts = 0;
+
 	while (!shouldQuit(player)) {
 		pthread_mutex_lock (&player->aoplayLock);
-		ret = av_buffersink_get_frame (player->fbufsink, filteredFrame);
-		if (ret == AVERROR_EOF || shouldQuit (player)) {
+		/* drain the previous filter graph first after a swap */
+		AVFilterContext * const sink = player->oldFbufsink != NULL ?
+				player->oldFbufsink : player->fbufsink;
+		ret = av_buffersink_get_frame (sink, filteredFrame);
+		if (ret == AVERROR_EOF && sink == player->oldFbufsink) {
+			debugPrint (DEBUG_AUDIO, "ao player drained old filter graph\n");
+			avfilter_graph_free (&player->oldFgraph);
+			player->oldFbufsink = NULL;
+			pthread_mutex_unlock (&player->aoplayLock);
+			continue;
+		} else if (ret == AVERROR_EOF || shouldQuit (player)) {
 			/* we are done here */
 			pthread_mutex_unlock (&player->aoplayLock);
 			debugPrint (DEBUG_AUDIO, "ao player got EOF, exiting\n");
+			eof = ret == AVERROR_EOF;
 			break;
 		} else if (ret < 0) {
 			/* wait for more frames */
@@ -580,19 +1410,48 @@ void *BarAoPlayThread (void *data) {
 			pthread_mutex_unlock (&player->aoplayLock);
 			continue;
 		}
+		timeBase = av_q2d (av_buffersink_get_time_base (sink));
 		pthread_mutex_unlock (&player->aoplayLock);
 
-		const int numChannels = av_get_channel_layout_nb_channels (
-				filteredFrame->channel_layout);
-		const int bps = av_get_bytes_per_sample (filteredFrame->format);
-		ao_play (player->aoDev, (char *) filteredFrame->data[0],
-				filteredFrame->nb_samples * numChannels * bps);
-
 		const double timestamp = (double) filteredFrame->pts * timeBase;
-		const unsigned int songPlayed = timestamp;
+		lastPts = filteredFrame->pts;
+
+		bool silent = false;
+		if (trimSilence) {
+			const int numChannels = av_get_channel_layout_nb_channels (
+					filteredFrame->channel_layout);
+			assert (filteredFrame->format == avformat);
+			silent = peakS16 ((const int16_t *) filteredFrame->data[0],
+					filteredFrame->nb_samples * numChannels) <= silenceThreshold;
+		}
+
+		AVFrame *copy = NULL;
+		if (silent && !audible) {
+			/* leading silence, skip it but keep the clock running */
+			pthread_mutex_lock (&player->lock);
+			player->songPlayed = timestamp;
+			pthread_mutex_unlock (&player->lock);
+		} else if (silent &&
+				(copy = av_frame_clone (filteredFrame)) != NULL) {
+			silenceQueuePush (&held, copy);
+			while (held.samples > maxHeldSamples) {
+				AVFrame *f = silenceQueuePop (&held);
+				aoPlayFrame (player, f, timeBase);
+				av_frame_free (&f);
+			}
+		} else {
+			/* silence in the middle of a track is played as usual, so is
+			 * silence that cannot be held back */
+			AVFrame *f;
+			while ((f = silenceQueuePop (&held)) != NULL) {
+				aoPlayFrame (player, f, timeBase);
+				av_frame_free (&f);
+			}
+			aoPlayFrame (player, filteredFrame, timeBase);
+			audible = true;
+		}
 
 		pthread_mutex_lock (&player->lock);
-		player->songPlayed = songPlayed;
 		/* pausing */
 		if (player->doPause) {
 			do {
@@ -614,6 +1473,26 @@ void *BarAoPlayThread (void *data) {
 
 		av_frame_unref (filteredFrame);
 	}
+
+	if (held.count > 0) {
+		debugPrint (DEBUG_AUDIO, "ao player dropped %"PRIi64" samples of "
+				"trailing silence\n", held.samples);
+	}
+	AVFrame *f;
+	while ((f = silenceQueuePop (&held)) != NULL) {
+		av_frame_free (&f);
+	}
+	free (held.frames);
+	if (eof) {
+		player->output->drain (player);
+	}
+	if (eof && trimSilence) {
+		/* trailing silence counts as played */
+		pthread_mutex_lock (&player->lock);
+		player->songPlayed = (double) lastPts * timeBase;
+		pthread_mutex_unlock (&player->lock);
+	}
+
 	av_frame_free (&filteredFrame);
 	debugPrint (DEBUG_AUDIO, "ao player is done\n");
 
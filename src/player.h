@@ -31,7 +31,6 @@ THE SOFTWARE.
 #include <stdint.h>
 #include <signal.h>
 
-#include <ao/ao.h>
 #include <libavformat/avformat.h>
 #include <libavfilter/avfilter.h>
 #include <piano.h>
@@ -74,7 +73,16 @@ typedef struct {
 	int64_t lastTimestamp;
 	sig_atomic_t interrupted;
 
-	ao_device *aoDev;
+	/* filter graph hot-swap, protected by aoplayLock. next* is installed by
+	 * the decoder between two frames, old* is drained by the ao thread. */
+	AVFilterGraph *nextFgraph, *oldFgraph;
+	AVFilterContext *nextFvolume, *nextFabuf, *nextFbufsink, *oldFbufsink;
+	/* filter arguments of the current stream, required for rebuilding */
+	char fabufArgs[256], fafmtArgs[256];
+
+	/* audio output backend, see player.c */
+	const struct BarPlayerOutput *output;
+	void *outputData;
 
 	/* settings (must be set before starting the thread) */
 	double gain;
@@ -87,6 +95,7 @@ enum {PLAYER_RET_OK = 0, PLAYER_RET_HARDFAIL = 1, PLAYER_RET_SOFTFAIL = 2};
 void *BarPlayerThread (void *data);
 void *BarAoPlayThread (void *data);
 void BarPlayerSetVolume (player_t * const player);
+bool BarPlayerSetDspChain (player_t * const player, const char * const chain);
 void BarPlayerInit (player_t * const p, const BarSettings_t * const settings);
 void BarPlayerReset (player_t * const p);
 void BarPlayerDestroy (player_t * const p);
@@ -0,0 +1,204 @@
+/*
+Copyright (c) 2020
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* retry policy for rpc calls: exponential backoff with jitter for single
+ * requests and a circuit breaker per request type, which fails fast after
+ * repeated transient errors instead of hammering pandora (or a dead
+ * network). */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "retry.h"
+#include "debug.h"
+
+/* backoff base and cap (ms) */
+#define DELAY_BASE 500
+#define DELAY_MAX 30000
+/* consecutive failures that open the breaker */
+#define BREAKER_THRESHOLD 5
+/* time the breaker stays open (seconds), doubled each time it opens again */
+#define BREAKER_COOLDOWN 10
+#define BREAKER_COOLDOWN_MAX 300
+
+void BarRetryInit (BarRetry_t * const r) {
+	memset (r, 0, sizeof (*r));
+	r->seed = (unsigned int) time (NULL) ^ (unsigned int) getpid ();
+}
+
+/*	delay before retry number attempt (starting at 0), in ms. Uses “equal
+ *	jitter”, so concurrent clients do not retry in lockstep.
+ */
+long BarRetryDelay (BarRetry_t * const r, const unsigned int attempt) {
+	long delay = DELAY_MAX;
+	if (attempt < 16) {
+		delay = DELAY_BASE << attempt;
+		if (delay > DELAY_MAX) {
+			delay = DELAY_MAX;
+		}
+	}
+	return delay/2 + rand_r (&r->seed) % (delay/2 + 1);
+}
+
+/*	is this error likely to go away by itself?
+ */
+bool BarRetryTransient (const PianoReturn_t pRet, const CURLcode wRet) {
+	switch (wRet) {
+		case CURLE_OK:
+			break;
+
+		case CURLE_OPERATION_TIMEDOUT:
+		case CURLE_COULDNT_RESOLVE_PROXY:
+		case CURLE_COULDNT_RESOLVE_HOST:
+		case CURLE_COULDNT_CONNECT:
+		case CURLE_SSL_CONNECT_ERROR:
+		case CURLE_SEND_ERROR:
+		case CURLE_RECV_ERROR:
+		case CURLE_GOT_NOTHING:
+		case CURLE_PARTIAL_FILE:
+		case CURLE_HTTP2:
+		case CURLE_HTTP2_STREAM:
+			return true;
+
+		default:
+			return false;
+	}
+
+	switch (pRet) {
+		case PIANO_RET_P_INTERNAL:
+		case PIANO_RET_P_MAINTENANCE_MODE:
+		case PIANO_RET_P_READ_ONLY_MODE:
+		case PIANO_RET_P_RATE_LIMIT:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+/*	may a request of type be sent again after a transport error? All pandora
+ *	calls are POSTs. Errors after the request may have reached pandora are
+ *	only retried for requests without side effects, pandora might have
+ *	applied the others already.
+ */
+bool BarRetryRepeatable (const PianoRequestType_t type, const CURLcode wRet) {
+	if (!BarRetryTransient (PIANO_RET_OK, wRet)) {
+		return false;
+	}
+
+	switch (wRet) {
+		case CURLE_COULDNT_RESOLVE_PROXY:
+		case CURLE_COULDNT_RESOLVE_HOST:
+		case CURLE_COULDNT_CONNECT:
+		case CURLE_SSL_CONNECT_ERROR:
+			/* nothing was sent */
+			return true;
+
+		default:
+			break;
+	}
+
+	switch (type) {
+		case PIANO_REQUEST_LOGIN:
+		case PIANO_REQUEST_GET_STATIONS:
+		case PIANO_REQUEST_GET_PLAYLIST:
+		case PIANO_REQUEST_SEARCH:
+		case PIANO_REQUEST_GET_GENRE_STATIONS:
+		case PIANO_REQUEST_EXPLAIN:
+		case PIANO_REQUEST_GET_STATION_INFO:
+		case PIANO_REQUEST_GET_SETTINGS:
+		case PIANO_REQUEST_GET_STATION_MODES:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+static BarRetryBreaker_t *BarRetryGetBreaker (BarRetry_t * const r,
+		const PianoRequestType_t type) {
+	assert (type < BAR_RETRY_ENDPOINTS);
+	return &r->breakers[type];
+}
+
+/*	may a request of type be sent? If not, pRet/wRet are set to the error
+ *	that opened the breaker and remaining to the time it stays open.
+ */
+bool BarRetryAllow (BarRetry_t * const r, const PianoRequestType_t type,
+		PianoReturn_t * const pRet, CURLcode * const wRet,
+		time_t * const remaining) {
+	const BarRetryBreaker_t * const b = BarRetryGetBreaker (r, type);
+	const time_t now = time (NULL);
+
+	if (now >= b->openUntil) {
+		/* closed or half-open, a single failure reopens it */
+		return true;
+	}
+
+	++r->fastFails;
+	*pRet = b->pRet;
+	*wRet = b->wRet;
+	*remaining = b->openUntil - now;
+	return false;
+}
+
+/*	record the final result of a request of type
+ */
+void BarRetryResult (BarRetry_t * const r, const PianoRequestType_t type,
+		const PianoReturn_t pRet, const CURLcode wRet) {
+	BarRetryBreaker_t * const b = BarRetryGetBreaker (r, type);
+
+	if (wRet == CURLE_ABORTED_BY_CALLBACK) {
+		/* user interrupt, says nothing about the endpoint */
+		return;
+	}
+
+	if (!BarRetryTransient (pRet, wRet)) {
+		/* pandora answered */
+		b->failures = 0;
+		b->trips = 0;
+		b->openUntil = 0;
+		return;
+	}
+
+	b->pRet = pRet;
+	b->wRet = wRet;
+	++b->failures;
+	if (b->failures >= BREAKER_THRESHOLD) {
+		time_t cooldown = BREAKER_COOLDOWN_MAX;
+		if (b->trips < 8) {
+			cooldown = BREAKER_COOLDOWN << b->trips;
+			if (cooldown > BREAKER_COOLDOWN_MAX) {
+				cooldown = BREAKER_COOLDOWN_MAX;
+			}
+		}
+		++b->trips;
+		b->openUntil = time (NULL) + cooldown;
+		debugPrint (DEBUG_NETWORK, "breaker for request %d open for %ld s\n",
+				type, (long) cooldown);
+	}
+}
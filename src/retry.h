@@ -0,0 +1,62 @@
+/*
+Copyright (c) 2020
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <time.h>
+#include <curl/curl.h>
+
+#include <piano.h>
+
+/* one breaker per request type */
+#define BAR_RETRY_ENDPOINTS 32
+
+typedef struct {
+	/* consecutive transient failures and how often the breaker opened in
+	 * a row */
+	unsigned int failures, trips;
+	/* fail fast until then */
+	time_t openUntil;
+	/* reported while open */
+	PianoReturn_t pRet;
+	CURLcode wRet;
+} BarRetryBreaker_t;
+
+typedef struct {
+	BarRetryBreaker_t breakers[BAR_RETRY_ENDPOINTS];
+	unsigned int seed;
+	/* statistics */
+	unsigned long retries, fastFails;
+} BarRetry_t;
+
+void BarRetryInit (BarRetry_t * const);
+long BarRetryDelay (BarRetry_t * const, const unsigned int);
+bool BarRetryTransient (const PianoReturn_t, const CURLcode);
+bool BarRetryRepeatable (const PianoRequestType_t, const CURLcode);
+bool BarRetryAllow (BarRetry_t * const, const PianoRequestType_t,
+		PianoReturn_t * const, CURLcode * const, time_t * const);
+void BarRetryResult (BarRetry_t * const, const PianoRequestType_t,
+		const PianoReturn_t, const CURLcode);
@@ -0,0 +1,669 @@
+/*
+Copyright (c) 2020
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* asynchronous http transport for libpiano requests, based on curl’s multi
+ * interface. Transfers are driven by BarRpcPerform, which is called from the
+ * main loop’s select() (see BarReadline) or BarRpcWait. */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <errno.h>
+
+#include "rpc.h"
+#include "ui.h"
+#include "debug.h"
+
+/*	set up the transfer queue
+ *	@return false if a capture file could not be opened
+ */
+bool BarRpcInit (BarRpc_t * const rpc, const BarSettings_t * const settings) {
+	memset (rpc, 0, sizeof (*rpc));
+	rpc->settings = settings;
+	BarRetryInit (&rpc->retry);
+	BarMetricsInit (&rpc->metrics);
+	if (!BarCaptureInit (&rpc->capture, settings->rpcRecord,
+			settings->rpcReplay, settings->rpcReplayRealtime)) {
+		/* replaying silently from nothing or recording nowhere is never
+		 * what the user wanted */
+		BarUiMsg (settings, MSG_ERR, "Cannot open capture file %s: %s\n",
+				settings->rpcReplay != NULL ? settings->rpcReplay :
+				settings->rpcRecord, strerror (errno));
+		return false;
+	}
+	rpc->multi = curl_multi_init ();
+	assert (rpc->multi != NULL);
+	/* connections are cached by the multi handle and shared by all of its
+	 * transfers. Multiplex concurrent requests over a single HTTP/2
+	 * connection. */
+	curl_multi_setopt (rpc->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+	/* dns and tls sessions survive easy handle cleanup */
+	rpc->share = curl_share_init ();
+	assert (rpc->share != NULL);
+	curl_share_setopt (rpc->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	curl_share_setopt (rpc->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+	return true;
+}
+
+/*	monotonic clock in ms
+ */
+static long long BarRpcNow (void) {
+	struct timespec now;
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	return (long long) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*	get an easy handle, reusing idle ones
+ */
+static CURL *BarRpcGetHandle (BarRpc_t * const rpc) {
+	CURL *http;
+	if (rpc->poolSize > 0) {
+		--rpc->poolSize;
+		http = rpc->pool[rpc->poolSize];
+		curl_easy_reset (http);
+	} else {
+		http = curl_easy_init ();
+		assert (http != NULL);
+	}
+	return http;
+}
+
+static void BarRpcPutHandle (BarRpc_t * const rpc, CURL * const http) {
+	if (rpc->poolSize < sizeof (rpc->pool) / sizeof (*rpc->pool)) {
+		rpc->pool[rpc->poolSize] = http;
+		++rpc->poolSize;
+	} else {
+		curl_easy_cleanup (http);
+	}
+}
+
+static void BarRpcFreeTransfer (BarRpc_t * const rpc,
+		BarRpcTransfer_t * const t) {
+	if (t->http != NULL) {
+		BarRpcPutHandle (rpc, t->http);
+	}
+	curl_slist_free_all (t->headers);
+	PianoArenaDestroy (t->arena);
+	PianoResponseParserDestroy (t->parser);
+	free (t);
+}
+
+/*	abort all running transfers. userdata is not freed.
+ */
+void BarRpcDestroy (BarRpc_t * const rpc) {
+	BarRpcTransfer_t *t = rpc->transfers;
+	while (t != NULL) {
+		BarRpcTransfer_t * const next = t->next;
+		if (t->http != NULL) {
+			curl_multi_remove_handle (rpc->multi, t->http);
+		}
+		BarRpcFreeTransfer (rpc, t);
+		t = next;
+	}
+	for (size_t i = 0; i < rpc->poolSize; i++) {
+		curl_easy_cleanup (rpc->pool[i]);
+	}
+	debugPrint (DEBUG_NETWORK, "%lu requests, %lu reused a connection\n",
+			rpc->requests, rpc->reused);
+	debugPrint (DEBUG_NETWORK, "%.3f s parsing, largest response %zu bytes, "
+			"peak %zu bytes\n", rpc->parseTime, rpc->maxResponse, rpc->maxPeak);
+	BarCaptureDestroy (&rpc->capture);
+	BarMetricsDestroy (&rpc->metrics);
+	curl_multi_cleanup (rpc->multi);
+	curl_share_cleanup (rpc->share);
+	memset (rpc, 0, sizeof (*rpc));
+}
+
+/*	discard received data, the transfer is restarted
+ */
+static void BarRpcResetBody (BarRpcTransfer_t * const t) {
+	PianoArenaDestroy (t->arena);
+	t->arena = NULL;
+	t->data = NULL;
+	t->pos = 0;
+	t->size = 0;
+	PianoResponseParserDestroy (t->parser);
+	t->parser = NULL;
+}
+
+/*	feed received chunk to the response parser; if that fails PianoResponse
+ *	reports it
+ */
+static void BarRpcParse (BarRpcTransfer_t * const t, const char * const ptr,
+		const size_t len) {
+	if (t->parser == NULL && t->pos == len) {
+		t->parser = PianoResponseParserNew ();
+	}
+	if (t->parser != NULL) {
+		struct timespec start, end;
+		clock_gettime (CLOCK_MONOTONIC, &start);
+		if (!PianoResponseParserFeed (t->parser, ptr, len)) {
+			PianoResponseParserDestroy (t->parser);
+			t->parser = NULL;
+		}
+		clock_gettime (CLOCK_MONOTONIC, &end);
+		t->parseTime += (end.tv_sec - start.tv_sec) +
+				(end.tv_nsec - start.tv_nsec) / 1e9;
+	}
+}
+
+static size_t httpFetchCb (char *ptr, size_t size, size_t nmemb,
+		void *userdata) {
+	BarRpcTransfer_t * const t = userdata;
+	size_t recvSize = size * nmemb;
+
+	if (t->pos + recvSize + 1 > t->size) {
+		size_t newSize;
+		if (t->size == 0) {
+			/* presize if the server told us */
+			curl_off_t length = -1;
+			curl_easy_getinfo (t->http, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T,
+					&length);
+			newSize = length > 0 ? (size_t) length + 1 : 16*1024;
+			if (newSize < t->pos + recvSize + 1) {
+				newSize = t->pos + recvSize + 1;
+			}
+		} else {
+			/* grow geometrically, responses arrive in many small chunks */
+			newSize = t->size * 2;
+			while (newSize < t->pos + recvSize + 1) {
+				newSize *= 2;
+			}
+		}
+		/* the first block holds exactly the buffer */
+		if (t->arena == NULL && (t->arena = PianoArenaNew (newSize)) == NULL) {
+			return 0;
+		}
+		char * const newbuf = PianoArenaRealloc (t->arena, t->data, t->pos,
+				sizeof (*t->data) * newSize);
+		if (newbuf == NULL) {
+			return 0;
+		}
+		t->data = newbuf;
+		t->size = newSize;
+	}
+	memcpy (t->data + t->pos, ptr, recvSize);
+	t->pos += recvSize;
+	t->data[t->pos] = '\0';
+
+	BarRpcParse (t, ptr, recvSize);
+
+	return recvSize;
+}
+
+/*	libcurl progress callback. aborts the current request if user pressed ^C
+ */
+static int progressCb (void * const data, double dltotal, double dlnow,
+		double ultotal, double ulnow) {
+	const BarRpcTransfer_t * const t = data;
+	if (t->interrupted != NULL && *t->interrupted) {
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+/*	serve transfer from the capture file instead of the network. It is done
+ *	after the original duration or right away.
+ */
+static void BarRpcReplay (BarRpc_t * const rpc, BarRpcTransfer_t * const t,
+		const PianoRequest_t * const req) {
+	const BarCaptureEntry_t * const e = BarCaptureNext (&rpc->capture, req);
+
+	t->replay = true;
+	t->retryAt = t->started;
+	if (e == NULL) {
+		debugPrint (DEBUG_NETWORK, "no capture for %s\n", t->url);
+		t->ret = CURLE_COULDNT_CONNECT;
+		return;
+	}
+
+	t->ret = e->ret;
+	if (rpc->capture.realtime) {
+		t->retryAt += e->duration;
+	}
+	if (e->responseLen > 0) {
+		if ((t->arena = PianoArenaNew (e->responseLen + 1)) == NULL ||
+				(t->data = PianoArenaAlloc (t->arena,
+				e->responseLen + 1)) == NULL) {
+			t->ret = CURLE_OUT_OF_MEMORY;
+			return;
+		}
+		memcpy (t->data, e->response, e->responseLen + 1);
+		t->pos = e->responseLen;
+		t->size = e->responseLen + 1;
+		BarRpcParse (t, t->data, t->pos);
+	}
+}
+
+#define setAndCheck(k,v) \
+	httpret = curl_easy_setopt (http, k, v); \
+	assert (httpret == CURLE_OK);
+
+/*	start a new transfer for the (prepared) request req after delay ms.
+ *	Synchronous transfers (userdata == NULL) must be waited for with
+ *	BarRpcWait, all other transfers are returned by BarRpcNextDone once they
+ *	are finished.
+ */
+BarRpcTransfer_t *BarRpcStart (BarRpc_t * const rpc,
+		const PianoRequest_t * const req, sig_atomic_t * const interrupted,
+		void * const userdata, const long delay) {
+	const BarSettings_t * const settings = rpc->settings;
+
+	BarRpcTransfer_t * const t = calloc (1, sizeof (*t));
+	assert (t != NULL);
+	t->interrupted = interrupted;
+	t->userdata = userdata;
+	t->started = BarRpcNow () + (delay > 0 ? delay : 0);
+	t->sent = strlen (req->postData);
+	t->type = req->type;
+
+	assert (settings->rpcHost != NULL);
+	assert (settings->rpcPort != NULL);
+	assert (settings->rpcTlsPort != NULL);
+	assert (req->urlPath != NULL);
+	int ret = snprintf (t->url, sizeof (t->url), "%s://%s:%s%s",
+		req->secure ? "https" : "http",
+		settings->rpcHost,
+		req->secure ? settings->rpcTlsPort : settings->rpcPort,
+		req->urlPath);
+	assert (ret >= 0 && ret <= (int) sizeof (t->url));
+	debugPrint (DEBUG_NETWORK, "← %s\n", t->url);
+
+	if (rpc->capture.replay) {
+		BarRpcReplay (rpc, t, req);
+		t->next = rpc->transfers;
+		rpc->transfers = t;
+		return t;
+	}
+
+	t->http = BarRpcGetHandle (rpc);
+	CURL * const http = t->http;
+	CURLcode httpret;
+	setAndCheck (CURLOPT_URL, t->url);
+	setAndCheck (CURLOPT_USERAGENT, PACKAGE "-" VERSION);
+	/* post data is copied, the request may be destroyed before the transfer
+	 * is done */
+	setAndCheck (CURLOPT_COPYPOSTFIELDS, req->postData);
+	setAndCheck (CURLOPT_WRITEFUNCTION, httpFetchCb);
+	setAndCheck (CURLOPT_WRITEDATA, t);
+	setAndCheck (CURLOPT_PROGRESSFUNCTION, progressCb);
+	setAndCheck (CURLOPT_PROGRESSDATA, t);
+	setAndCheck (CURLOPT_NOPROGRESS, 0);
+	setAndCheck (CURLOPT_POST, 1);
+	setAndCheck (CURLOPT_TIMEOUT, settings->timeout);
+	setAndCheck (CURLOPT_PRIVATE, t);
+	setAndCheck (CURLOPT_SHARE, rpc->share);
+	/* keep connections to the rpc host warm */
+	setAndCheck (CURLOPT_TCP_KEEPALIVE, 1L);
+	setAndCheck (CURLOPT_TCP_KEEPIDLE, 60L);
+	setAndCheck (CURLOPT_TCP_KEEPINTVL, 30L);
+	/* http/2 for https only, falls back to http/1.1 */
+	if (curl_easy_setopt (http, CURLOPT_HTTP_VERSION,
+			CURL_HTTP_VERSION_2TLS) != CURLE_OK) {
+		debugPrint (DEBUG_NETWORK, "libcurl does not support http/2\n");
+	}
+	/* wait for an existing connection to multiplex instead of opening a new
+	 * one */
+	setAndCheck (CURLOPT_PIPEWAIT, 1L);
+	if (settings->caBundle != NULL) {
+		setAndCheck (CURLOPT_CAINFO, settings->caBundle);
+	}
+
+	if (settings->bindTo!= NULL) {
+		if (curl_easy_setopt (http, CURLOPT_INTERFACE,
+				settings->bindTo) != CURLE_OK) {
+			/* if binding fails, notice about that */
+			BarUiMsg (settings, MSG_ERR, "bindTo (%s) is invalid!\n",
+					settings->bindTo);
+		}
+	}
+
+	/* set up proxy (control proxy for non-us citizen or global proxy for poor
+	 * firewalled fellows) */
+	if (settings->controlProxy != NULL) {
+		/* control proxy overrides global proxy */
+		if (curl_easy_setopt (http, CURLOPT_PROXY,
+				settings->controlProxy) != CURLE_OK) {
+			/* if setting proxy fails, url is invalid */
+			BarUiMsg (settings, MSG_ERR, "Control proxy (%s) is invalid!\n",
+					 settings->controlProxy);
+		}
+	} else if (settings->proxy != NULL && strlen (settings->proxy) > 0) {
+		if (curl_easy_setopt (http, CURLOPT_PROXY,
+				settings->proxy) != CURLE_OK) {
+			/* if setting proxy fails, url is invalid */
+			BarUiMsg (settings, MSG_ERR, "Proxy (%s) is invalid!\n",
+					 settings->proxy);
+		}
+	}
+
+	if (req->arena != NULL) {
+		size_t allocs, blocks, bytes;
+		PianoArenaStats (req->arena, &allocs, &blocks, &bytes);
+		rpc->arenaAllocs += allocs;
+		rpc->arenaBlocks += blocks;
+	}
+
+	t->headers = curl_slist_append (t->headers, "Content-Type: text/plain");
+	setAndCheck (CURLOPT_HTTPHEADER, t->headers);
+
+	t->next = rpc->transfers;
+	rpc->transfers = t;
+	if (delay > 0) {
+		t->retryAt = BarRpcNow () + delay;
+	} else {
+		const CURLMcode mret = curl_multi_add_handle (rpc->multi, http);
+		assert (mret == CURLM_OK);
+	}
+
+	return t;
+}
+
+#undef setAndCheck
+
+/*	transfers that are still running
+ */
+static bool BarRpcActive (const BarRpc_t * const rpc) {
+	for (const BarRpcTransfer_t *t = rpc->transfers; t != NULL; t = t->next) {
+		if (!t->done) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*	transfers that are handled by curl right now
+ */
+static bool BarRpcCurlActive (const BarRpc_t * const rpc) {
+	for (const BarRpcTransfer_t *t = rpc->transfers; t != NULL; t = t->next) {
+		if (!t->done && t->retryAt == 0 && !t->replay) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*	time until the next deferred transfer must be started (ms) or -1
+ */
+static long BarRpcNextRetry (const BarRpc_t * const rpc) {
+	long long next = -1;
+	for (const BarRpcTransfer_t *t = rpc->transfers; t != NULL; t = t->next) {
+		if (!t->done && t->retryAt != 0 && (next == -1 || t->retryAt < next)) {
+			next = t->retryAt;
+		}
+	}
+	if (next == -1) {
+		return -1;
+	}
+	const long long now = BarRpcNow ();
+	return next > now ? next - now : 0;
+}
+
+/*	record response size and peak memory. Body and document are both alive
+ *	once the response is complete, which is when memory use peaks.
+ */
+static void BarRpcUpdateSizes (BarRpc_t * const rpc,
+		const BarRpcTransfer_t * const t) {
+	const size_t peak = t->size + PianoResponseParserSize (t->parser);
+	if (t->pos > rpc->maxResponse) {
+		rpc->maxResponse = t->pos;
+	}
+	if (peak > rpc->maxPeak) {
+		rpc->maxPeak = peak;
+	}
+	debugPrint (DEBUG_NETWORK, "peak memory %zu bytes (body %zu, document "
+			"~%zu)\n", peak, t->size, PianoResponseParserSize (t->parser));
+}
+
+/*	start deferred transfers that are due, finish interrupted ones
+ */
+static void BarRpcStartDeferred (BarRpc_t * const rpc) {
+	const long long now = BarRpcNow ();
+	for (BarRpcTransfer_t *t = rpc->transfers; t != NULL; t = t->next) {
+		if (t->done || t->retryAt == 0) {
+			continue;
+		}
+		if (t->interrupted != NULL && *t->interrupted) {
+			t->retryAt = 0;
+			t->ret = CURLE_ABORTED_BY_CALLBACK;
+			t->done = true;
+			t->finished = now;
+		} else if (t->retryAt <= now && t->replay) {
+			t->retryAt = 0;
+			t->done = true;
+			t->finished = now;
+			++rpc->requests;
+			rpc->parseTime += t->parseTime;
+			BarRpcUpdateSizes (rpc, t);
+			debugPrint (DEBUG_NETWORK, "→ %s\n", t->data);
+		} else if (t->retryAt <= now) {
+			t->retryAt = 0;
+			curl_multi_add_handle (rpc->multi, t->http);
+		}
+	}
+}
+
+/*	add curl’s file descriptors to the sets and lower timeout (ms, -1 is
+ *	infinite) if curl needs to be called earlier
+ */
+void BarRpcFdset (BarRpc_t * const rpc, fd_set * const readSet,
+		fd_set * const writeSet, fd_set * const exceptSet, int * const maxfd,
+		long * const timeout) {
+	if (!BarRpcActive (rpc)) {
+		return;
+	}
+
+	int curlMaxfd = -1;
+	curl_multi_fdset (rpc->multi, readSet, writeSet, exceptSet, &curlMaxfd);
+	long curlTimeout = -1;
+	curl_multi_timeout (rpc->multi, &curlTimeout);
+	const long retryTimeout = BarRpcNextRetry (rpc);
+	if (curlMaxfd == -1 && curlTimeout != 0 && retryTimeout == -1) {
+		/* no socket yet (name resolution), poll */
+		curlTimeout = 100;
+	}
+	if (retryTimeout >= 0 && (curlTimeout < 0 || retryTimeout < curlTimeout)) {
+		curlTimeout = retryTimeout;
+	}
+
+	/* maxfd is highest fd + 1 */
+	if (curlMaxfd >= *maxfd) {
+		*maxfd = curlMaxfd + 1;
+	}
+	if (curlTimeout >= 0 && (*timeout < 0 || curlTimeout < *timeout)) {
+		*timeout = curlTimeout;
+	}
+}
+
+/*	make progress on all transfers, does not block
+ */
+void BarRpcPerform (BarRpc_t * const rpc) {
+	int running, left;
+	CURLMsg *msg;
+
+	BarRpcStartDeferred (rpc);
+	curl_multi_perform (rpc->multi, &running);
+
+	while ((msg = curl_multi_info_read (rpc->multi, &left)) != NULL) {
+		if (msg->msg != CURLMSG_DONE) {
+			continue;
+		}
+
+		BarRpcTransfer_t *t = NULL;
+		curl_easy_getinfo (msg->easy_handle, CURLINFO_PRIVATE, (char **) &t);
+		assert (t != NULL);
+		const CURLcode ret = msg->data.result;
+		curl_multi_remove_handle (rpc->multi, t->http);
+
+		++t->retry;
+		const bool transient = BarRetryTransient (PIANO_RET_OK, ret);
+		if (BarRetryRepeatable (t->type, ret) &&
+				t->retry < rpc->settings->maxRetry) {
+			const long delay = BarRetryDelay (&rpc->retry, t->retry - 1);
+			debugPrint (DEBUG_NETWORK, "%s, retrying %s in %ld ms\n",
+					curl_easy_strerror (ret), t->url, delay);
+			++rpc->retry.retries;
+			BarRpcResetBody (t);
+			t->retryAt = BarRpcNow () + delay;
+			continue;
+		}
+
+		if (transient) {
+			BarRpcResetBody (t);
+		}
+		t->ret = ret;
+		t->done = true;
+		t->finished = BarRpcNow ();
+
+		long newConnections = 0, httpVersion = 0;
+		curl_easy_getinfo (t->http, CURLINFO_NUM_CONNECTS, &newConnections);
+		curl_easy_getinfo (t->http, CURLINFO_HTTP_VERSION, &httpVersion);
+		++rpc->requests;
+		if (ret == CURLE_OK && newConnections == 0) {
+			++rpc->reused;
+		}
+		debugPrint (DEBUG_NETWORK, "%s connection, http version %ld, "
+				"reuse rate %lu/%lu\n", newConnections == 0 ? "reused" : "new",
+				httpVersion, rpc->reused, rpc->requests);
+		rpc->parseTime += t->parseTime;
+		BarRpcUpdateSizes (rpc, t);
+		size_t allocs = 0, blocks = 0, bytes = 0;
+		if (t->arena != NULL) {
+			PianoArenaStats (t->arena, &allocs, &blocks, &bytes);
+			rpc->arenaAllocs += allocs;
+			rpc->arenaBlocks += blocks;
+		}
+		debugPrint (DEBUG_NETWORK, "%zu bytes, parsed in %.3f ms, "
+				"%zu allocations in %zu blocks\n", t->pos,
+				t->parseTime * 1000.0, allocs, blocks);
+		debugPrint (DEBUG_NETWORK, "→ %s\n", t->data);
+	}
+}
+
+/*	block until transfer is done, all other transfers make progress as well
+ */
+CURLcode BarRpcWait (BarRpc_t * const rpc, BarRpcTransfer_t * const t) {
+	BarRpcPerform (rpc);
+	while (!t->done) {
+		int numfds;
+		long timeout = BarRpcNextRetry (rpc);
+		if (timeout < 0 || timeout > 1000) {
+			timeout = 1000;
+		}
+		if (BarRpcCurlActive (rpc)) {
+			curl_multi_wait (rpc->multi, NULL, 0, timeout, &numfds);
+		} else {
+			/* curl has nothing to wait for and would return immediately */
+			const struct timespec sleep = {timeout / 1000,
+					(timeout % 1000) * 1000000};
+			nanosleep (&sleep, NULL);
+		}
+		BarRpcPerform (rpc);
+	}
+	return t->ret;
+}
+
+/*	is there an asynchronous transfer waiting for BarRpcNextDone?
+ */
+bool BarRpcHasDone (const BarRpc_t * const rpc) {
+	for (const BarRpcTransfer_t *t = rpc->transfers; t != NULL; t = t->next) {
+		if (t->done && t->userdata != NULL) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*	get finished asynchronous transfer, the caller must BarRpcFinish it
+ */
+BarRpcTransfer_t *BarRpcNextDone (BarRpc_t * const rpc) {
+	/* list is prepended, the oldest transfer is last */
+	BarRpcTransfer_t *found = NULL;
+	for (BarRpcTransfer_t *t = rpc->transfers; t != NULL; t = t->next) {
+		if (t->done && t->userdata != NULL) {
+			found = t;
+		}
+	}
+	return found;
+}
+
+/*	abort transfer, BarRpcFinish must be called afterwards. Transfers that
+ *	completed already keep their result.
+ */
+void BarRpcCancel (BarRpc_t * const rpc, BarRpcTransfer_t * const t) {
+	if (t->done) {
+		return;
+	}
+	/* replayed transfers have no handle, deferred ones are not added yet */
+	if (t->http != NULL && t->retryAt == 0) {
+		curl_multi_remove_handle (rpc->multi, t->http);
+	}
+	t->retryAt = 0;
+	t->ret = CURLE_ABORTED_BY_CALLBACK;
+	t->done = true;
+	t->finished = BarRpcNow ();
+}
+
+/*	hand response over to request and destroy transfer
+ */
+void BarRpcFinish (BarRpc_t * const rpc, BarRpcTransfer_t * const t,
+		PianoRequest_t * const req) {
+	assert (t->done);
+
+	BarRpcTransfer_t **prev = &rpc->transfers;
+	while (*prev != t) {
+		assert (*prev != NULL);
+		prev = &(*prev)->next;
+	}
+	*prev = t->next;
+
+	/* user-initiated aborts are not worth replaying or measuring */
+	if (t->ret != CURLE_ABORTED_BY_CALLBACK) {
+		BarCaptureRecord (&rpc->capture, req, t->ret,
+				(long) (t->finished - t->started), t->data, t->pos);
+		BarMetricsTransfer (&rpc->metrics, req->type, t->http, t->ret,
+				t->finished - t->started, t->parseTime, t->sent, t->pos,
+				t->retry > 0 ? t->retry - 1 : 0);
+	}
+
+	req->responseData = t->data;
+	t->data = NULL;
+	if (t->arena != NULL) {
+		if (req->arena == NULL) {
+			req->arena = t->arena;
+		} else {
+			PianoArenaAdopt (req->arena, t->arena);
+		}
+		t->arena = NULL;
+	}
+	/* a parser that failed has been dropped, PianoResponse retries */
+	PianoResponseParserDestroy (req->responseParser);
+	req->responseParser = t->parser;
+	t->parser = NULL;
+	BarRpcFreeTransfer (rpc, t);
+}
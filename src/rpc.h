@@ -0,0 +1,105 @@
+/*
+Copyright (c) 2020
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <signal.h>
+#include <sys/select.h>
+#include <curl/curl.h>
+
+#include <piano.h>
+
+#include "settings.h"
+#include "retry.h"
+#include "capture.h"
+#include "metrics.h"
+
+/* a single http request to the rpc host */
+typedef struct BarRpcTransfer {
+	struct BarRpcTransfer *next;
+	CURL *http;
+	struct curl_slist *headers;
+	char url[2048];
+	/* response body and allocated size, owned by arena */
+	PianoArena_t *arena;
+	char *data;
+	size_t pos, size;
+	/* parses the body while it is received */
+	PianoResponseParser_t *parser;
+	double parseTime;
+	/* abort transfer if this becomes != 0, may be NULL */
+	sig_atomic_t *interrupted;
+	unsigned int retry;
+	/* waiting for a retry until then (monotonic, ms), 0 if running */
+	long long retryAt;
+	/* request body size */
+	size_t sent;
+	PianoRequestType_t type;
+	/* first attempt and completion (monotonic, ms) */
+	long long started, finished;
+	/* served from a capture file, no curl handle */
+	bool replay;
+	CURLcode ret;
+	bool done;
+	/* NULL for synchronous transfers */
+	void *userdata;
+} BarRpcTransfer_t;
+
+typedef struct {
+	CURLM *multi;
+	/* dns cache and tls sessions */
+	CURLSH *share;
+	BarRpcTransfer_t *transfers;
+	/* idle easy handles */
+	CURL *pool[4];
+	size_t poolSize;
+	/* number of finished requests and how many reused a connection */
+	unsigned long requests, reused;
+	/* time spent parsing responses, largest response body and peak memory
+	 * of a single response (body buffer plus parsed document) */
+	double parseTime;
+	size_t maxResponse, maxPeak;
+	/* arena allocations and blocks (malloc calls) for all requests */
+	unsigned long arenaAllocs, arenaBlocks;
+	const BarSettings_t *settings;
+	BarRetry_t retry;
+	BarCapture_t capture;
+	BarMetrics_t metrics;
+} BarRpc_t;
+
+bool BarRpcInit (BarRpc_t * const, const BarSettings_t * const);
+void BarRpcDestroy (BarRpc_t * const);
+BarRpcTransfer_t *BarRpcStart (BarRpc_t * const, const PianoRequest_t * const,
+		sig_atomic_t * const, void * const, const long);
+void BarRpcFdset (BarRpc_t * const, fd_set * const, fd_set * const,
+		fd_set * const, int * const, long * const);
+void BarRpcPerform (BarRpc_t * const);
+CURLcode BarRpcWait (BarRpc_t * const, BarRpcTransfer_t * const);
+bool BarRpcHasDone (const BarRpc_t * const);
+BarRpcTransfer_t *BarRpcNextDone (BarRpc_t * const);
+void BarRpcCancel (BarRpc_t * const, BarRpcTransfer_t * const);
+void BarRpcFinish (BarRpc_t * const, BarRpcTransfer_t * const,
+		PianoRequest_t * const);
@@ -63,25 +63,36 @@ static char *BarSettingsGetHome () {
 	return NULL;
 }
 
-/*	Get XDG config directory, which is set by BarSettingsRead (if not set)
+/*	Get filename in XDG directory from environment variable var
  */
-static char *BarGetXdgConfigDir (const char * const filename) {
+static char *BarGetXdgDir (const char * const var,
+		const char * const filename) {
 	assert (filename != NULL);
 
-	char *xdgConfigDir;
+	char *xdgDir;
 
-	if ((xdgConfigDir = getenv ("XDG_CONFIG_HOME")) != NULL &&
-			strlen (xdgConfigDir) > 0) {
-		const size_t len = (strlen (xdgConfigDir) + 1 +
-				strlen (filename) + 1);
+	if ((xdgDir = getenv (var)) != NULL && strlen (xdgDir) > 0) {
+		const size_t len = (strlen (xdgDir) + 1 + strlen (filename) + 1);
 		char * const concat = malloc (len * sizeof (*concat));
-		snprintf (concat, len, "%s/%s", xdgConfigDir, filename);
+		snprintf (concat, len, "%s/%s", xdgDir, filename);
 		return concat;
 	}
 
 	return NULL;
 }
 
+/*	Get XDG config directory, which is set by BarSettingsRead (if not set)
+ */
+char *BarGetXdgConfigDir (const char * const filename) {
+	return BarGetXdgDir ("XDG_CONFIG_HOME", filename);
+}
+
+/*	Get XDG cache directory, which is set by BarSettingsRead (if not set)
+ */
+char *BarGetXdgCacheDir (const char * const filename) {
+	return BarGetXdgDir ("XDG_CACHE_HOME", filename);
+}
+
 /*	Expand ~/ to user’s home directory
  */
 char *BarSettingsExpandTilde (const char * const path, const char * const home) {
@@ -126,8 +137,17 @@ void BarSettingsDestroy (BarSettings_t *settings) {
 	free (settings->listSongFormat);
 	free (settings->timeFormat);
 	free (settings->fifo);
+	free (settings->sessionFile);
+	free (settings->rpcRecord);
+	free (settings->rpcReplay);
+	free (settings->metricsFile);
 	free (settings->audioPipe);
+	free (settings->audioOutput);
+	free (settings->audioFile);
+	free (settings->alsaDevice);
+	free (settings->dspChain);
 	free (settings->rpcHost);
+	free (settings->rpcPort);
 	free (settings->rpcTlsPort);
 	free (settings->partnerUser);
 	free (settings->partnerPassword);
@@ -154,6 +174,11 @@ void BarSettingsRead (BarSettings_t *settings) {
 	sprintf (defaultxdg, "%s/.config", userhome);
 	setenv ("XDG_CONFIG_HOME", defaultxdg, 0);
 	free (defaultxdg);
+	char * const defaultxdgcache = malloc (strlen (userhome) +
+			strlen ("/.cache") + 1);
+	sprintf (defaultxdgcache, "%s/.cache", userhome);
+	setenv ("XDG_CACHE_HOME", defaultxdgcache, 0);
+	free (defaultxdgcache);
 
 	assert (sizeof (settings->keys) / sizeof (*settings->keys) ==
 			sizeof (dispatchActions) / sizeof (*dispatchActions));
@@ -162,6 +187,12 @@ void BarSettingsRead (BarSettings_t *settings) {
 	settings->audioQuality = PIANO_AQ_HIGH;
 	settings->autoselect = true;
 	settings->history = 5;
+	settings->playlistPrefetch = 2;
+	settings->stationRefresh = 900;
+	settings->cacheTtlStations = 600;
+	settings->cacheTtlGenres = 86400;
+	settings->cacheTtlStationInfo = 300;
+	settings->cacheMaxAge = 7*86400;
 	settings->volume = 0;
 	settings->timeout = 30; /* seconds */
 	settings->gainMul = 1.0;
@@ -178,6 +209,7 @@ void BarSettingsRead (BarSettings_t *settings) {
 	settings->listSongFormat = strdup ("%i) %a - %t%r");
 	settings->timeFormat = strdup ("%s%r/%t");
 	settings->rpcHost = strdup (PIANO_RPC_HOST);
+	settings->rpcPort = strdup ("80");
 	settings->rpcTlsPort = strdup ("443");
 	settings->partnerUser = strdup ("android");
 	settings->partnerPassword = strdup ("AC7IBG09A3DTSYM4R41UJWL07VLN8JI7");
@@ -185,9 +217,21 @@ void BarSettingsRead (BarSettings_t *settings) {
 	settings->inkey = strdup ("R=U!LH$O2B#");
 	settings->outkey = strdup ("6#26FRL$ZWD");
 	settings->fifo = BarGetXdgConfigDir (PACKAGE "/ctl");
+	settings->sessionFile = BarGetXdgConfigDir (PACKAGE "/session");
+	settings->persistAuth = true;
+	settings->rpcReplayRealtime = true;
+	settings->metricsFile = BarGetXdgConfigDir (PACKAGE "/metrics");
 	settings->audioPipe = NULL;
+	settings->audioOutput = NULL;
+	settings->audioFile = NULL;
+	settings->alsaDevice = strdup ("default");
+	settings->alsaPeriodTime = 20;
+	settings->alsaBufferTime = 80;
+	settings->dspChain = NULL;
 	assert (settings->fifo != NULL);
 	settings->sampleRate = 0; /* default to stream sample rate */
+	settings->trimSilence = false;
+	settings->silenceThreshold = -60;
 
 	settings->msgFormat[MSG_NONE].prefix = NULL;
 	settings->msgFormat[MSG_NONE].postfix = NULL;
@@ -296,6 +340,9 @@ void BarSettingsRead (BarSettings_t *settings) {
 			} else if (streq ("rpc_host", key)) {
 				free (settings->rpcHost);
 				settings->rpcHost = strdup (val);
+			} else if (streq ("rpc_port", key)) {
+				free (settings->rpcPort);
+				settings->rpcPort = strdup (val);
 			} else if (streq ("rpc_tls_port", key)) {
 				free (settings->rpcTlsPort);
 				settings->rpcTlsPort = strdup (val);
@@ -345,6 +392,18 @@ void BarSettingsRead (BarSettings_t *settings) {
 				settings->eventCmd = BarSettingsExpandTilde (val, userhome);
 			} else if (streq ("history", key)) {
 				settings->history = atoi (val);
+			} else if (streq ("playlist_prefetch", key)) {
+				settings->playlistPrefetch = atoi (val);
+			} else if (streq ("station_refresh", key)) {
+				settings->stationRefresh = atoi (val);
+			} else if (streq ("cache_ttl_stations", key)) {
+				settings->cacheTtlStations = atoi (val);
+			} else if (streq ("cache_ttl_genres", key)) {
+				settings->cacheTtlGenres = atoi (val);
+			} else if (streq ("cache_ttl_station_info", key)) {
+				settings->cacheTtlStationInfo = atoi (val);
+			} else if (streq ("cache_max_age", key)) {
+				settings->cacheMaxAge = atoi (val);
 			} else if (streq ("max_retry", key)) {
 				settings->maxRetry = atoi (val);
 			} else if (streq ("timeout", key)) {
@@ -397,13 +456,49 @@ void BarSettingsRead (BarSettings_t *settings) {
 			} else if (streq ("fifo", key)) {
 				free (settings->fifo);
 				settings->fifo = BarSettingsExpandTilde (val, userhome);
+			} else if (streq ("session_file", key)) {
+				free (settings->sessionFile);
+				settings->sessionFile = BarSettingsExpandTilde (val, userhome);
+			} else if (streq ("persist_auth", key)) {
+				settings->persistAuth = atoi (val);
+			} else if (streq ("rpc_record", key)) {
+				free (settings->rpcRecord);
+				settings->rpcRecord = BarSettingsExpandTilde (val, userhome);
+			} else if (streq ("rpc_replay", key)) {
+				free (settings->rpcReplay);
+				settings->rpcReplay = BarSettingsExpandTilde (val, userhome);
+			} else if (streq ("rpc_replay_realtime", key)) {
+				settings->rpcReplayRealtime = atoi (val);
+			} else if (streq ("metrics_file", key)) {
+				free (settings->metricsFile);
+				settings->metricsFile = BarSettingsExpandTilde (val, userhome);
 			} else if (streq ("audio_pipe", key)) {
 				free (settings->audioPipe);
 				settings->audioPipe = BarSettingsExpandTilde (val, userhome);
+			} else if (streq ("audio_output", key)) {
+				free (settings->audioOutput);
+				settings->audioOutput = strdup (val);
+			} else if (streq ("audio_file", key)) {
+				free (settings->audioFile);
+				settings->audioFile = BarSettingsExpandTilde (val, userhome);
+			} else if (streq ("alsa_device", key)) {
+				free (settings->alsaDevice);
+				settings->alsaDevice = strdup (val);
+			} else if (streq ("alsa_period_time", key)) {
+				settings->alsaPeriodTime = atoi (val);
+			} else if (streq ("alsa_buffer_time", key)) {
+				settings->alsaBufferTime = atoi (val);
+			} else if (streq ("dsp_chain", key)) {
+				free (settings->dspChain);
+				settings->dspChain = strdup (val);
 			} else if (streq ("autoselect", key)) {
 				settings->autoselect = atoi (val);
 			} else if (streq ("sample_rate", key)) {
 				settings->sampleRate = atoi (val);
+			} else if (streq ("trim_silence", key)) {
+				settings->trimSilence = atoi (val);
+			} else if (streq ("silence_threshold", key)) {
+				settings->silenceThreshold = atoi (val);
 			} else if (strncmp (formatMsgPrefix, key,
 					strlen (formatMsgPrefix)) == 0) {
 				static const char *mapping[] = {"none", "info", "nowplaying",
@@ -59,8 +59,10 @@ typedef enum {
 	BAR_KS_PAUSE = 27,
 	BAR_KS_VOLRESET = 28,
 	BAR_KS_SETTINGS = 29,
+	BAR_KS_DSPCHAIN = 30,
+	BAR_KS_METRICS = 31,
 	/* insert new shortcuts _before_ this element and increase its value */
-	BAR_KS_COUNT = 30,
+	BAR_KS_COUNT = 32,
 } BarKeyShortcutId_t;
 
 #define BAR_KS_DISABLED '\x00'
@@ -85,6 +87,13 @@ typedef struct {
 typedef struct {
 	bool autoselect;
 	unsigned int history, maxRetry, timeout, bufferSecs;
+	unsigned int playlistPrefetch;
+	/* refresh station list in the background, seconds */
+	unsigned int stationRefresh;
+	/* response cache lifetime, seconds */
+	unsigned int cacheTtlStations, cacheTtlGenres, cacheTtlStationInfo;
+	/* stale cache entries older than this are discarded, seconds */
+	unsigned int cacheMaxAge;
 	int volume;
 	float gainMul;
 	BarStationSorting_t sortOrder;
@@ -101,11 +110,19 @@ typedef struct {
 	char *npSongFormat;
 	char *npStationFormat;
 	char *listSongFormat, *timeFormat;
-	char *fifo;
-	char *rpcHost, *rpcTlsPort, *partnerUser, *partnerPassword, *device, *inkey, *outkey, *caBundle;
-	char *audioPipe;
+	char *fifo, *sessionFile;
+	bool persistAuth;
+	char *rpcRecord, *rpcReplay, *metricsFile;
+	bool rpcReplayRealtime;
+	char *rpcHost, *rpcPort, *rpcTlsPort, *partnerUser, *partnerPassword, *device, *inkey, *outkey, *caBundle;
+	char *audioPipe, *audioOutput, *audioFile;
+	char *alsaDevice;
+	unsigned int alsaPeriodTime, alsaBufferTime; /* ms */
+	char *dspChain; /* protected by player lock */
 	char keys[BAR_KS_COUNT];
 	int sampleRate;
+	bool trimSilence;
+	int silenceThreshold; /* dBFS */
 	BarMsgFormatStr_t msgFormat[MSG_COUNT];
 } BarSettings_t;
 
@@ -115,4 +132,6 @@ void BarSettingsInit (BarSettings_t *);
 void BarSettingsDestroy (BarSettings_t *);
 void BarSettingsRead (BarSettings_t *);
 void BarSettingsWrite (PianoStation_t *, BarSettings_t *);
+char *BarGetXdgConfigDir (const char * const);
+char *BarGetXdgCacheDir (const char * const);
 
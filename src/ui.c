@@ -33,7 +33,7 @@ THE SOFTWARE.
 #include <errno.h>
 #include <strings.h>
 #include <assert.h>
-#include <ctype.h> /* tolower() */
+#include <ctype.h> /* isdigit() */
 
 /* waitpid () */
 #include <sys/types.h>
@@ -42,6 +42,8 @@ THE SOFTWARE.
 #include "ui.h"
 #include "debug.h"
 #include "ui_readline.h"
+#include "auth.h"
+#include "filter.h"
 
 typedef int (*BarSortFunc_t) (const void *, const void *);
 
@@ -60,31 +62,19 @@ static bool isnumeric (const char *s) {
 	return true;
 }
 
-/*	find needle in haystack, ignoring case, and return first position
+/*	run filter query and announce approximate matches
+ *	@return matching entry ids
  */
-static const char *BarStrCaseStr (const char *haystack, const char *needle) {
-	const char *needlePos = needle;
-
-	assert (haystack != NULL);
-	assert (needle != NULL);
-
-	if (*needle == '\0') {
-		return haystack;
+static const size_t *BarUiFilter (const BarSettings_t * const settings,
+		BarFilter_t * const filter, const char * const query,
+		size_t * const retCount, bool * const retFuzzy) {
+	const size_t * const matches = BarFilterMatch (filter, query, retCount,
+			retFuzzy);
+	if (*retFuzzy) {
+		BarUiMsg (settings, MSG_INFO, "No match for \"%s\", closest:\n",
+				query);
 	}
-
-	while (*haystack != '\0') {
-		if (tolower ((unsigned char) *haystack) == tolower ((unsigned char) *needlePos)) {
-			++needlePos;
-		} else {
-			needlePos = needle;
-		}
-		++haystack;
-		if (*needlePos == '\0') {
-			return haystack - strlen (needle);
-		}
-	}
-
-	return NULL;
+	return matches;
 }
 
 /*	output message and flush stdout
@@ -128,146 +118,147 @@ void BarUiMsg (const BarSettings_t *settings, const BarUiMsg_t type,
 	fflush (stdout);
 }
 
-typedef struct {
-	char *data;
-	size_t pos;
-} buffer;
+/*	PianoResponse, timed
+ */
+static PianoReturn_t BarUiPianoResponse (BarApp_t * const app,
+		PianoRequest_t * const req) {
+	struct timespec start, end;
 
-static size_t httpFetchCb (char *ptr, size_t size, size_t nmemb,
-		void *userdata) {
-	buffer * const buffer = userdata;
-	size_t recvSize = size * nmemb;
+	clock_gettime (CLOCK_MONOTONIC, &start);
+	const PianoReturn_t ret = PianoResponse (&app->ph, req);
+	clock_gettime (CLOCK_MONOTONIC, &end);
+	BarMetricsResponse (&app->rpc.metrics, req->type, ret,
+			(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
 
-	if (buffer->data == NULL) {
-		if ((buffer->data = malloc (sizeof (*buffer->data) *
-				(recvSize + 1))) == NULL) {
-			return 0;
-		}
-	} else {
-		char *newbuf;
-		if ((newbuf = realloc (buffer->data, sizeof (*buffer->data) *
-				(buffer->pos + recvSize + 1))) == NULL) {
-			free (buffer->data);
-			return 0;
+	return ret;
+}
+
+/*	perform http request synchronously, aborted by ^C
+ */
+static CURLcode BarPianoHttpRequest (BarRpc_t * const rpc,
+		PianoRequest_t * const req, const long delay) {
+	sig_atomic_t lint = 0, *prevint;
+
+	/* save the previous interrupt destination */
+	prevint = interrupted;
+	interrupted = &lint;
+
+	BarRpcTransfer_t * const t = BarRpcStart (rpc, req, &lint, NULL, delay);
+	const CURLcode httpret = BarRpcWait (rpc, t);
+	BarRpcFinish (rpc, t, req);
+
+	interrupted = prevint;
+
+	return httpret;
+}
+
+/*	get cache key and lifetime for request, NULL if it is not cached
+ */
+static char *BarUiCacheKey (const BarApp_t * const app,
+		const PianoRequestType_t type, const void * const data,
+		time_t * const ttl) {
+	const BarSettings_t * const settings = &app->settings;
+	char key[256];
+
+	switch (type) {
+		case PIANO_REQUEST_GET_STATIONS:
+			*ttl = settings->cacheTtlStations;
+			strcpy (key, "stations");
+			break;
+
+		case PIANO_REQUEST_GET_GENRE_STATIONS:
+			*ttl = settings->cacheTtlGenres;
+			strcpy (key, "genres");
+			break;
+
+		case PIANO_REQUEST_GET_STATION_INFO: {
+			const PianoRequestDataGetStationInfo_t * const reqData = data;
+			*ttl = settings->cacheTtlStationInfo;
+			snprintf (key, sizeof (key), "info-%s", reqData->station->id);
+			break;
 		}
-		buffer->data = newbuf;
+
+		default:
+			return NULL;
 	}
-	memcpy (buffer->data + buffer->pos, ptr, recvSize);
-	buffer->pos += recvSize;
-	buffer->data[buffer->pos] = '\0';
 
-	return recvSize;
+	return *ttl > 0 ? strdup (key) : NULL;
 }
 
-/*	libcurl progress callback. aborts the current request if user pressed ^C
+/*	drop cached station info
  */
-int progressCb (void * const data, double dltotal, double dlnow,
-		double ultotal, double ulnow) {
-	const sig_atomic_t lint = *((sig_atomic_t *) data);
-	if (lint) {
-		return 1;
-	} else {
-		return 0;
+void BarUiCacheDropStationInfo (BarApp_t * const app,
+		const char * const stationId) {
+	if (stationId != NULL) {
+		char key[256];
+		snprintf (key, sizeof (key), "info-%s", stationId);
+		BarCacheDrop (&app->cache, key);
 	}
 }
 
-#define setAndCheck(k,v) \
-	httpret = curl_easy_setopt (http, k, v); \
-	assert (httpret == CURLE_OK);
-
-static CURLcode BarPianoHttpRequest (CURL * const http,
-		const BarSettings_t * const settings, PianoRequest_t * const req) {
-	buffer buffer = {NULL, 0};
-	sig_atomic_t lint = 0, *prevint;
-
-	char url[2048];
-	assert (settings->rpcHost != NULL);
-	assert (settings->rpcTlsPort != NULL);
-	assert (req->urlPath != NULL);
-	int ret = snprintf (url, sizeof (url), "%s://%s:%s%s",
-		req->secure ? "https" : "http",
-		settings->rpcHost,
-		req->secure ? settings->rpcTlsPort : "80",
-		req->urlPath);
-	assert (ret >= 0 && ret <= (int) sizeof (url));
-	debugPrint (DEBUG_NETWORK, "← %s\n", url);
+/*	bookkeeping after a successful call: store session and responses,
+ *	invalidate cache entries changed by req
+ */
+static void BarUiPianoCallDone (BarApp_t * const app,
+		const PianoRequest_t * const req) {
+	time_t ttl;
+	char * const key = BarUiCacheKey (app, req->type, req->data, &ttl);
+	if (key != NULL) {
+		BarCachePut (&app->cache, key, req->responseData);
+		free (key);
+		return;
+	}
 
-	/* save the previous interrupt destination */
-	prevint = interrupted;
-	interrupted = &lint;
+	if (app->stationRefresh != NULL &&
+			(req->type == PIANO_REQUEST_CREATE_STATION ||
+			req->type == PIANO_REQUEST_DELETE_STATION ||
+			req->type == PIANO_REQUEST_RENAME_STATION ||
+			req->type == PIANO_REQUEST_TRANSFORM_STATION ||
+			req->type == PIANO_REQUEST_SET_QUICKMIX ||
+			req->type == PIANO_REQUEST_ADD_SEED ||
+			req->type == PIANO_REQUEST_DELETE_SEED)) {
+		/* a station list refresh in flight may predate this change. Its
+		 * response is discarded and the refresh repeated. */
+		app->stationRefreshStale = true;
+	}
 
-	curl_easy_reset (http);
-	CURLcode httpret;
-	setAndCheck (CURLOPT_URL, url);
-	setAndCheck (CURLOPT_USERAGENT, PACKAGE "-" VERSION);
-	setAndCheck (CURLOPT_POSTFIELDS, req->postData);
-	setAndCheck (CURLOPT_WRITEFUNCTION, httpFetchCb);
-	setAndCheck (CURLOPT_WRITEDATA, &buffer);
-	setAndCheck (CURLOPT_PROGRESSFUNCTION, progressCb);
-	setAndCheck (CURLOPT_PROGRESSDATA, &lint);
-	setAndCheck (CURLOPT_NOPROGRESS, 0);
-	setAndCheck (CURLOPT_POST, 1);
-	setAndCheck (CURLOPT_TIMEOUT, settings->timeout);
-	if (settings->caBundle != NULL) {
-		setAndCheck (CURLOPT_CAINFO, settings->caBundle);
-	}
-
-	if (settings->bindTo!= NULL) {
-		if (curl_easy_setopt (http, CURLOPT_INTERFACE,
-				settings->bindTo) != CURLE_OK) {
-			/* if binding fails, notice about that */
-			BarUiMsg (settings, MSG_ERR, "bindTo (%s) is invalid!\n",
-					settings->bindTo);
-		}
-	}
-
-	/* set up proxy (control proxy for non-us citizen or global proxy for poor
-	 * firewalled fellows) */
-	if (settings->controlProxy != NULL) {
-		/* control proxy overrides global proxy */
-		if (curl_easy_setopt (http, CURLOPT_PROXY,
-				settings->controlProxy) != CURLE_OK) {
-			/* if setting proxy fails, url is invalid */
-			BarUiMsg (settings, MSG_ERR, "Control proxy (%s) is invalid!\n",
-					 settings->controlProxy);
-		}
-	} else if (settings->proxy != NULL && strlen (settings->proxy) > 0) {
-		if (curl_easy_setopt (http, CURLOPT_PROXY,
-				settings->proxy) != CURLE_OK) {
-			/* if setting proxy fails, url is invalid */
-			BarUiMsg (settings, MSG_ERR, "Proxy (%s) is invalid!\n",
-					 settings->proxy);
-		}
-	}
-
-	struct curl_slist *list = NULL;
-	list = curl_slist_append (list, "Content-Type: text/plain");
-	setAndCheck (CURLOPT_HTTPHEADER, list);
-
-	unsigned int retry = 0;
-	do {
-		httpret = curl_easy_perform (http);
-		++retry;
-		if (httpret == CURLE_OPERATION_TIMEDOUT) {
-			free (buffer.data);
-			buffer.data = NULL;
-			buffer.pos = 0;
-			if (retry >= settings->maxRetry) {
-				break;
+	switch (req->type) {
+		case PIANO_REQUEST_LOGIN:
+			if (app->settings.persistAuth) {
+				BarAuthSave (&app->ph, app->settings.sessionFile,
+						app->settings.username, app->settings.password);
 			}
-		} else {
+			break;
+
+		case PIANO_REQUEST_DELETE_STATION: {
+			const PianoStation_t * const station = req->data;
+			BarUiCacheDropStationInfo (app, station->id);
+			BarCacheDrop (&app->cache, "stations");
 			break;
 		}
-	} while (true);
 
-	curl_slist_free_all (list);
+		case PIANO_REQUEST_CREATE_STATION:
+		case PIANO_REQUEST_RENAME_STATION:
+		case PIANO_REQUEST_TRANSFORM_STATION:
+		case PIANO_REQUEST_SET_QUICKMIX:
+			BarCacheDrop (&app->cache, "stations");
+			break;
 
-	req->responseData = buffer.data;
-	debugPrint (DEBUG_NETWORK, "→ %s\n", req->responseData);
+		case PIANO_REQUEST_ADD_SEED: {
+			const PianoRequestDataAddSeed_t * const reqData = req->data;
+			BarUiCacheDropStationInfo (app, reqData->station->id);
+			break;
+		}
 
-	interrupted = prevint;
+		case PIANO_REQUEST_RATE_SONG: {
+			const PianoRequestDataRateSong_t * const reqData = req->data;
+			BarUiCacheDropStationInfo (app, reqData->song->stationId);
+			break;
+		}
 
-	return httpret;
+		default:
+			break;
+	}
 }
 
 /*	piano wrapper: prepare/execute http request and pass result back to
@@ -278,6 +269,20 @@ bool BarUiPianoCall (BarApp_t * const app, const PianoRequestType_t type,
 	PianoReturn_t pRetLocal = PIANO_RET_OK;
 	CURLcode wRetLocal = CURLE_OK;
 	bool ret = false;
+	unsigned int attempt = 0;
+	long delay = 0;
+
+	time_t remaining;
+	if (!BarRetryAllow (&app->rpc.retry, type, &pRetLocal, &wRetLocal,
+			&remaining)) {
+		BarUiMsg (&app->settings, MSG_NONE, "Error: %s Not trying again for "
+				"%lds.\n", wRetLocal != CURLE_OK ?
+				curl_easy_strerror (wRetLocal) : PianoErrorToStr (pRetLocal),
+				(long) remaining);
+		*pRet = pRetLocal;
+		*wRet = wRetLocal;
+		return false;
+	}
 
 	/* repeat as long as there are http requests to do */
 	do {
@@ -290,7 +295,8 @@ bool BarUiPianoCall (BarApp_t * const app, const PianoRequestType_t type,
 			goto cleanup;
 		}
 
-		wRetLocal = BarPianoHttpRequest (app->http, &app->settings, &req);
+		wRetLocal = BarPianoHttpRequest (&app->rpc, &req, delay);
+		delay = 0;
 		if (wRetLocal == CURLE_ABORTED_BY_CALLBACK) {
 			BarUiMsg (&app->settings, MSG_NONE, "Interrupted.\n");
 			goto cleanup;
@@ -300,7 +306,7 @@ bool BarUiPianoCall (BarApp_t * const app, const PianoRequestType_t type,
 			goto cleanup;
 		}
 
-		pRetLocal = PianoResponse (&app->ph, &req);
+		pRetLocal = BarUiPianoResponse (app, &req);
 		if (pRetLocal != PIANO_RET_CONTINUE_REQUEST) {
 			/* checking for request type avoids infinite loops */
 			if (pRetLocal == PIANO_RET_P_INVALID_AUTH_TOKEN &&
@@ -311,6 +317,7 @@ bool BarUiPianoCall (BarApp_t * const app, const PianoRequestType_t type,
 				reqData.password = app->settings.password;
 				reqData.step = 0;
 
+				BarMetricsReauth (&app->rpc.metrics, type);
 				BarUiMsg (&app->settings, MSG_NONE,
 						"Reauthentication required... ");
 				if (!BarUiPianoCall (app, PIANO_REQUEST_LOGIN, &reqData,
@@ -321,28 +328,467 @@ bool BarUiPianoCall (BarApp_t * const app, const PianoRequestType_t type,
 					pRetLocal = PIANO_RET_CONTINUE_REQUEST;
 					BarUiMsg (&app->settings, MSG_INFO, "Trying again... ");
 				}
+			} else if (BarRetryTransient (pRetLocal, CURLE_OK) &&
+					attempt + 1 < app->settings.maxRetry) {
+				/* back off and repeat this step */
+				delay = BarRetryDelay (&app->rpc.retry, attempt);
+				++attempt;
+				++app->rpc.retry.retries;
+				BarMetricsRetry (&app->rpc.metrics, type);
+				BarUiMsg (&app->settings, MSG_NONE, "Error: %s Retrying in "
+						"%.1fs... ", PianoErrorToStr (pRetLocal), delay / 1000.0);
+				pRetLocal = PIANO_RET_CONTINUE_REQUEST;
 			} else if (pRetLocal != PIANO_RET_OK) {
 				BarUiMsg (&app->settings, MSG_NONE, "Error: %s\n",
 						PianoErrorToStr (pRetLocal));
 				goto cleanup;
 			} else {
 				BarUiMsg (&app->settings, MSG_NONE, "Ok.\n");
+				BarUiPianoCallDone (app, &req);
 				ret = true;
 			}
 		}
 
 cleanup:
 		/* persistent data is stored in req.data */
-		free (req.responseData);
 		PianoDestroyRequest (&req);
 	} while (pRetLocal == PIANO_RET_CONTINUE_REQUEST);
 
+	BarRetryResult (&app->rpc.retry, type, pRetLocal, wRetLocal);
+
 	*pRet = pRetLocal;
 	*wRet = wRetLocal;
 
 	return ret;
 }
 
+/*	state of an asynchronous piano call
+ */
+typedef struct {
+	PianoRequestType_t type, curType;
+	void *data, *curData;
+	/* reauthentication */
+	PianoRequestDataLogin_t login;
+	PianoRequest_t req;
+	BarUiPianoCallback_t callback;
+	void *userdata;
+	/* do not print anything */
+	bool quiet;
+	/* retries of the current step */
+	unsigned int attempt;
+} BarUiAsyncCall_t;
+
+static void BarUiPianoAsyncComplete (BarApp_t * const app,
+		BarUiAsyncCall_t * const call, const PianoReturn_t pRet,
+		const CURLcode wRet) {
+	BarRetryResult (&app->rpc.retry, call->type, pRet, wRet);
+	call->callback (app, call->type, call->data, pRet, wRet, call->userdata);
+	free (call);
+}
+
+/*	prepare next request and start transfer after delay ms, returns false if
+ *	the call is finished
+ */
+static bool BarUiPianoAsyncStart (BarApp_t * const app,
+		BarUiAsyncCall_t * const call, const long delay) {
+	memset (&call->req, 0, sizeof (call->req));
+	call->req.data = call->curData;
+
+	const PianoReturn_t pRet = PianoRequest (&app->ph, &call->req,
+			call->curType);
+	if (pRet != PIANO_RET_OK) {
+		if (!call->quiet) {
+			BarUiMsg (&app->settings, MSG_NONE, "Error: %s\n",
+					PianoErrorToStr (pRet));
+		}
+		PianoDestroyRequest (&call->req);
+		BarUiPianoAsyncComplete (app, call, pRet, CURLE_OK);
+		return false;
+	}
+
+	BarRpcStart (&app->rpc, &call->req, NULL, call, delay);
+	/* post data has been copied */
+	PianoDestroyRequest (&call->req);
+	call->req.data = call->curData;
+	call->req.type = call->curType;
+
+	return true;
+}
+
+/*	asynchronous version of BarUiPianoCall. callback is run from
+ *	BarUiPianoDispatch once the call is finished, data must stay valid until
+ *	then. Returns false if the request could not be started; the callback has
+ *	been run in that case. Quiet calls do not print progress or errors.
+ */
+bool BarUiPianoCallAsync (BarApp_t * const app, const PianoRequestType_t type,
+		void * const data, BarUiPianoCallback_t callback,
+		void * const userdata, const bool quiet) {
+	assert (callback != NULL);
+
+	BarUiAsyncCall_t * const call = calloc (1, sizeof (*call));
+	assert (call != NULL);
+	call->type = call->curType = type;
+	call->data = call->curData = data;
+	call->callback = callback;
+	call->userdata = userdata;
+	call->quiet = quiet;
+
+	PianoReturn_t pRet;
+	CURLcode wRet;
+	time_t remaining;
+	if (!BarRetryAllow (&app->rpc.retry, type, &pRet, &wRet, &remaining)) {
+		/* fail fast, without touching the breaker */
+		if (!quiet) {
+			BarUiMsg (&app->settings, MSG_NONE, "Error: Not trying again for "
+					"%lds.\n", (long) remaining);
+		}
+		callback (app, type, data, pRet, wRet, userdata);
+		free (call);
+		return false;
+	}
+
+	return BarUiPianoAsyncStart (app, call, 0);
+}
+
+/*	pass finished transfers to libpiano and run callbacks. Must be called from
+ *	the main loop only.
+ */
+void BarUiPianoDispatch (BarApp_t * const app) {
+	BarRpcTransfer_t *t;
+
+	while ((t = BarRpcNextDone (&app->rpc)) != NULL) {
+		BarUiAsyncCall_t * const call = t->userdata;
+		const CURLcode wRet = t->ret;
+		BarRpcFinish (&app->rpc, t, &call->req);
+
+		if (wRet != CURLE_OK) {
+			if (!call->quiet) {
+				BarUiMsg (&app->settings, MSG_NONE, "Network error: %s\n",
+						curl_easy_strerror (wRet));
+			}
+			PianoDestroyRequest (&call->req);
+			BarUiPianoAsyncComplete (app, call, PIANO_RET_OK, wRet);
+			continue;
+		}
+
+		if (call->curType == PIANO_REQUEST_GET_STATIONS &&
+				call->data == app->stationRefresh &&
+				app->stationRefreshStale) {
+			/* outdated station list, do not apply it */
+			PianoDestroyRequest (&call->req);
+			BarUiPianoAsyncComplete (app, call, PIANO_RET_OK, CURLE_OK);
+			continue;
+		}
+
+		PianoReturn_t pRet = BarUiPianoResponse (app, &call->req);
+		if (pRet == PIANO_RET_OK) {
+			BarUiPianoCallDone (app, &call->req);
+		}
+		PianoDestroyRequest (&call->req);
+
+		if (pRet == PIANO_RET_CONTINUE_REQUEST) {
+			call->attempt = 0;
+			BarUiPianoAsyncStart (app, call, 0);
+		} else if (BarRetryTransient (pRet, CURLE_OK) &&
+				call->attempt + 1 < app->settings.maxRetry) {
+			/* back off and repeat this step */
+			const long delay = BarRetryDelay (&app->rpc.retry, call->attempt);
+			++call->attempt;
+			++app->rpc.retry.retries;
+			BarMetricsRetry (&app->rpc.metrics, call->curType);
+			debugPrint (DEBUG_NETWORK, "%s, retrying in %ld ms\n",
+					PianoErrorToStr (pRet), delay);
+			BarUiPianoAsyncStart (app, call, delay);
+		} else if (pRet == PIANO_RET_P_INVALID_AUTH_TOKEN &&
+				call->curType != PIANO_REQUEST_LOGIN) {
+			/* reauthenticate, then restart the original request */
+			BarMetricsReauth (&app->rpc.metrics, call->type);
+			if (!call->quiet) {
+				BarUiMsg (&app->settings, MSG_INFO,
+						"Reauthentication required...\n");
+			}
+			call->login.user = app->settings.username;
+			call->login.password = app->settings.password;
+			call->login.step = 0;
+			call->curType = PIANO_REQUEST_LOGIN;
+			call->curData = &call->login;
+			BarUiPianoAsyncStart (app, call, 0);
+		} else if (pRet == PIANO_RET_OK && call->curType != call->type) {
+			/* login done */
+			call->curType = call->type;
+			call->curData = call->data;
+			BarUiPianoAsyncStart (app, call, 0);
+		} else {
+			if (call->quiet) {
+				/* nothing */
+			} else if (pRet != PIANO_RET_OK) {
+				BarUiMsg (&app->settings, MSG_NONE, "Error: %s\n",
+						PianoErrorToStr (pRet));
+			} else {
+				BarUiMsg (&app->settings, MSG_NONE, "Ok.\n");
+			}
+			BarUiPianoAsyncComplete (app, call, pRet, CURLE_OK);
+		}
+	}
+}
+
+/*	background revalidation of a cache entry finished
+ */
+static void BarUiCacheRevalidated (BarApp_t * const app,
+		const PianoRequestType_t type, void * const data,
+		const PianoReturn_t pRet, const CURLcode wRet,
+		void * const userdata) {
+	debugPrint (DEBUG_NETWORK, "cache revalidation of %d: %s/%s\n", type,
+			PianoErrorToStr (pRet), curl_easy_strerror (wRet));
+
+	if (type == PIANO_REQUEST_GET_STATION_INFO) {
+		/* the response is in the cache now, the caller is long gone */
+		PianoRequestDataGetStationInfo_t * const reqData = data;
+		PianoDestroyStationInfo (&reqData->info);
+		free (reqData->station->id);
+		free (reqData->station);
+		free (reqData);
+	}
+}
+
+/*	like BarUiPianoCall, but answer cacheable requests from the on-disk cache
+ *	if possible. Stale entries are used as well, but refreshed in the
+ *	background.
+ */
+bool BarUiPianoCallCached (BarApp_t * const app,
+		const PianoRequestType_t type, void * const data,
+		PianoReturn_t * const pRet, CURLcode * const wRet) {
+	time_t ttl;
+	bool stale = false;
+	char * const key = BarUiCacheKey (app, type, data, &ttl);
+	char * const body = key == NULL ? NULL :
+			BarCacheGet (&app->cache, key, ttl, &stale);
+	free (key);
+
+	if (body == NULL) {
+		return BarUiPianoCall (app, type, data, pRet, wRet);
+	}
+
+	PianoRequest_t req = { .type = type, .data = data, .responseData = body };
+	*pRet = PianoResponse (&app->ph, &req);
+	*wRet = CURLE_OK;
+	free (body);
+	if (*pRet != PIANO_RET_OK) {
+		/* corrupt entry, ask pandora */
+		return BarUiPianoCall (app, type, data, pRet, wRet);
+	}
+	BarUiMsg (&app->settings, MSG_NONE, "Ok.\n");
+
+	if (stale && type == PIANO_REQUEST_GET_STATIONS) {
+		/* the regular refresh prunes stations deleted elsewhere and drops
+		 * references to them */
+		app->stationRefreshAfter = 0;
+	} else if (stale) {
+		void *revalidateData = NULL;
+		if (type == PIANO_REQUEST_GET_STATION_INFO) {
+			/* caller’s data is gone when the response arrives */
+			const PianoRequestDataGetStationInfo_t * const reqData = data;
+			PianoRequestDataGetStationInfo_t * const copy =
+					calloc (1, sizeof (*copy));
+			assert (copy != NULL);
+			copy->station = calloc (1, sizeof (*copy->station));
+			assert (copy->station != NULL);
+			copy->station->id = strdup (reqData->station->id);
+			revalidateData = copy;
+		}
+		BarUiPianoCallAsync (app, type, revalidateData, BarUiCacheRevalidated,
+				NULL, true);
+	}
+
+	return true;
+}
+
+/*	abort all asynchronous calls, callbacks see CURLE_ABORTED_BY_CALLBACK
+ */
+void BarUiPianoCancel (BarApp_t * const app) {
+	BarRpcTransfer_t *t = app->rpc.transfers;
+	while (t != NULL) {
+		BarRpcTransfer_t * const next = t->next;
+		if (t->userdata != NULL) {
+			BarUiAsyncCall_t * const call = t->userdata;
+			BarRpcCancel (&app->rpc, t);
+			BarRpcFinish (&app->rpc, t, &call->req);
+			PianoDestroyRequest (&call->req);
+			BarUiPianoAsyncComplete (app, call, PIANO_RET_OK,
+					CURLE_ABORTED_BY_CALLBACK);
+		}
+		t = next;
+	}
+}
+
+/* pause after the rpc layer gave up on a feedback operation (seconds) */
+#define BAR_FEEDBACK_PAUSE 60
+
+/*	a feedback operation sent to pandora
+ */
+typedef struct {
+	PianoSong_t song;
+	PianoRequestDataRateSong_t rate;
+} BarUiFeedbackCall_t;
+
+/*	run eventcmd for a feedback operation that completed or was dropped. The
+ *	song is passed along if it is still around.
+ */
+static void BarUiFeedbackEvent (BarApp_t * const app,
+		const BarFeedbackOp_t * const op, const PianoReturn_t pRet,
+		const CURLcode wRet) {
+	static const char * const events[BAR_FB_COUNT] = {"songlove", "songban",
+			"songshelf", "songbookmark", "artistbookmark"};
+	const PianoSong_t *song = NULL;
+
+	assert (op->type < BAR_FB_COUNT);
+
+	const PianoSong_t *s = app->playlist;
+	PianoListForeachP (s) {
+		if (s->trackToken != NULL &&
+				strcmp (s->trackToken, op->trackToken) == 0) {
+			song = s;
+			break;
+		}
+	}
+	for (size_t i = 0; song == NULL && i < app->history.count; i++) {
+		s = BarHistoryGet (&app->history, i);
+		if (s->trackToken != NULL &&
+				strcmp (s->trackToken, op->trackToken) == 0) {
+			song = s;
+		}
+	}
+
+	BarUiStartEventCmd (&app->settings, events[op->type],
+			PianoFindStationById (&app->ph, op->stationId), song,
+			&app->player, &app->ph, pRet, wRet);
+}
+
+static void BarUiFeedbackCallback (BarApp_t * const app,
+		const PianoRequestType_t type, void * const data,
+		const PianoReturn_t pRet, const CURLcode wRet,
+		void * const userdata) {
+	BarFeedbackQueue_t * const q = &app->feedback;
+	BarUiFeedbackCall_t * const call = userdata;
+
+	free (call->song.stationId);
+	free (call->song.trackToken);
+	free (call);
+
+	q->inFlight = false;
+
+	if (wRet == CURLE_ABORTED_BY_CALLBACK) {
+		/* shutting down, the journal keeps it */
+		return;
+	}
+
+	if (wRet != CURLE_OK || BarRetryTransient (pRet, wRet)) {
+		/* the rpc layer retried with backoff already and gave up (or its
+		 * breaker is open), keep the operation and try again later */
+		++q->attempts;
+		q->retryAfter = time (NULL) + BAR_FEEDBACK_PAUSE;
+		debugPrint (DEBUG_NETWORK, "feedback %s failed, attempt %u\n",
+				BarFeedbackTypeToStr (q->head->type), q->attempts);
+		return;
+	}
+
+	if (pRet != PIANO_RET_OK) {
+		BarUiMsg (&app->settings, MSG_ERR, "Could not %s song: %s\n",
+				BarFeedbackTypeToStr (q->head->type), PianoErrorToStr (pRet));
+		++q->failed;
+	} else {
+		q->lastLatency = difftime (time (NULL), q->head->queued);
+		q->totalLatency += q->lastLatency;
+		++q->flushed;
+	}
+	BarUiFeedbackEvent (app, q->head, pRet, wRet);
+	BarFeedbackPop (q);
+}
+
+/*	send the oldest pending feedback operation to pandora, one at a time to
+ *	keep them in order. Must be called from the main loop only.
+ */
+void BarUiFeedbackFlush (BarApp_t * const app) {
+	BarFeedbackQueue_t * const q = &app->feedback;
+	const BarFeedbackOp_t * const op = q->head;
+
+	if (op == NULL || q->inFlight || time (NULL) < q->retryAfter) {
+		return;
+	}
+
+	BarUiFeedbackCall_t * const call = calloc (1, sizeof (*call));
+	assert (call != NULL);
+	call->song.stationId = strdup (op->stationId);
+	call->song.trackToken = strdup (op->trackToken);
+
+	PianoRequestType_t type;
+	void *data = &call->song;
+	switch (op->type) {
+		case BAR_FB_LOVE:
+		case BAR_FB_BAN:
+			type = PIANO_REQUEST_RATE_SONG;
+			call->rate.song = &call->song;
+			call->rate.rating = op->type == BAR_FB_LOVE ? PIANO_RATE_LOVE :
+					PIANO_RATE_BAN;
+			data = &call->rate;
+			break;
+
+		case BAR_FB_TIRED:
+			type = PIANO_REQUEST_ADD_TIRED_SONG;
+			break;
+
+		case BAR_FB_BOOKMARK_SONG:
+			type = PIANO_REQUEST_BOOKMARK_SONG;
+			break;
+
+		case BAR_FB_BOOKMARK_ARTIST:
+			type = PIANO_REQUEST_BOOKMARK_ARTIST;
+			break;
+
+		default:
+			assert (0);
+			return;
+	}
+
+	q->inFlight = true;
+	BarUiPianoCallAsync (app, type, data, BarUiFeedbackCallback, call, true);
+}
+
+/*	apply feedback to song locally and queue it for pandora. The eventcmd
+ *	runs once pandora accepted or rejected it.
+ */
+void BarUiFeedbackQueue (BarApp_t * const app, const BarFeedbackType_t type,
+		PianoSong_t * const song) {
+	assert (song != NULL);
+	assert (song->trackToken != NULL);
+
+	switch (type) {
+		case BAR_FB_LOVE:
+			song->rating = PIANO_RATE_LOVE;
+			break;
+
+		case BAR_FB_BAN:
+			song->rating = PIANO_RATE_BAN;
+			break;
+
+		case BAR_FB_TIRED:
+			song->rating = PIANO_RATE_TIRED;
+			break;
+
+		default:
+			break;
+	}
+
+	if (BarFeedbackPush (&app->feedback, type,
+			song->stationId != NULL ? song->stationId : "-",
+			song->trackToken)) {
+		BarUiMsg (&app->settings, MSG_NONE, "Queued.\n");
+	} else {
+		BarUiMsg (&app->settings, MSG_NONE, "Already queued.\n");
+	}
+	BarUiFeedbackFlush (app);
+}
+
 /*	Station sorting functions */
 
 static inline int BarStationQuickmix01Cmp (const void *a, const void *b) {
@@ -444,8 +890,9 @@ PianoStation_t *BarUiSelectStation (BarApp_t *app, PianoStation_t *stations,
 		const char *prompt, BarUiSelectStationCallback_t callback,
 		bool autoselect) {
 	PianoStation_t **sortedStations = NULL, *retStation = NULL;
-	size_t stationCount, i, lastDisplayed, displayCount;
+	size_t stationCount, i;
 	char buf[100];
+	BarFilter_t filter;
 
 	if (stations == NULL) {
 		BarUiMsg (&app->settings, MSG_ERR, "No station available.\n");
@@ -458,27 +905,32 @@ PianoStation_t *BarUiSelectStation (BarApp_t *app, PianoStation_t *stations,
 	sortedStations = BarSortedStations (stations, &stationCount,
 			app->settings.sortOrder);
 
+	BarFilterInit (&filter);
+	for (i = 0; i < stationCount; i++) {
+		const char * const fields[] = {sortedStations[i]->name};
+		BarFilterAdd (&filter, fields, 1);
+	}
+
 	do {
-		displayCount = 0;
-		for (i = 0; i < stationCount; i++) {
-			const PianoStation_t *currStation = sortedStations[i];
-			/* filter stations */
-			if (BarStrCaseStr (currStation->name, buf) != NULL) {
-				BarUiMsg (&app->settings, MSG_LIST, "%2zi) %c%c%c %s\n", i,
-						currStation->useQuickMix ? 'q' : ' ',
-						currStation->isQuickMix ? 'Q' : ' ',
-						!currStation->isCreator ? 'S' : ' ',
-						currStation->name);
-				++displayCount;
-				lastDisplayed = i;
-			}
+		size_t matchCount;
+		bool fuzzy;
+		/* filter stations */
+		const size_t * const matches = BarUiFilter (&app->settings, &filter,
+				buf, &matchCount, &fuzzy);
+		for (i = 0; i < matchCount; i++) {
+			const PianoStation_t *currStation = sortedStations[matches[i]];
+			BarUiMsg (&app->settings, MSG_LIST, "%2zi) %c%c%c %s\n", matches[i],
+					currStation->useQuickMix ? 'q' : ' ',
+					currStation->isQuickMix ? 'Q' : ' ',
+					!currStation->isCreator ? 'S' : ' ',
+					currStation->name);
 		}
 
 		BarUiMsg (&app->settings, MSG_QUESTION, "%s", prompt);
-		if (autoselect && displayCount == 1 && stationCount != 1) {
+		if (autoselect && !fuzzy && matchCount == 1 && stationCount != 1) {
 			/* auto-select last remaining station */
-			BarUiMsg (&app->settings, MSG_NONE, "%zi\n", lastDisplayed);
-			retStation = sortedStations[lastDisplayed];
+			BarUiMsg (&app->settings, MSG_NONE, "%zi\n", matches[0]);
+			retStation = sortedStations[matches[0]];
 		} else {
 			if (BarReadlineStr (buf, sizeof (buf), &app->input,
 					BAR_RL_DEFAULT) == 0) {
@@ -499,77 +951,150 @@ PianoStation_t *BarUiSelectStation (BarApp_t *app, PianoStation_t *stations,
 		}
 	} while (retStation == NULL);
 
+	BarFilterDestroy (&filter);
 	free (sortedStations);
 	return retStation;
 }
 
-/*	let user pick one song
- *	@param app
- *	@param song list
- *	@param input fds
- *	@return pointer to selected item in song list or NULL
+static void BarUiListSong (const BarApp_t * const, const PianoSong_t * const,
+		const size_t);
+
+/*	let user pick one song from either a list or the history
  */
-PianoSong_t *BarUiSelectSong (const BarApp_t * const app,
-		PianoSong_t *startSong, BarReadlineFds_t *input) {
+static PianoSong_t *BarUiSelectSongFrom (const BarApp_t * const app,
+		PianoSong_t *startSong, const BarHistory_t * const history,
+		BarReadlineFds_t *input) {
 	const BarSettings_t * const settings = &app->settings;
-	PianoSong_t *tmpSong = NULL;
+	PianoSong_t *tmpSong = NULL, **songs;
+	size_t songCount;
 	char buf[100];
+	BarFilter_t filter;
 
 	memset (buf, 0, sizeof (buf));
 
+	songCount = history != NULL ? history->count : PianoListCountP (startSong);
+	songs = calloc (songCount == 0 ? 1 : songCount, sizeof (*songs));
+	if (songs == NULL) {
+		return NULL;
+	}
+	BarFilterInit (&filter);
+	tmpSong = startSong;
+	for (size_t i = 0; i < songCount; i++) {
+		if (history != NULL) {
+			songs[i] = BarHistoryGet (history, i);
+		} else {
+			songs[i] = tmpSong;
+			tmpSong = PianoListNextP (tmpSong);
+		}
+		const char * const fields[] = {songs[i]->artist, songs[i]->title};
+		BarFilterAdd (&filter, fields, 2);
+	}
+	tmpSong = NULL;
+
 	do {
-		BarUiListSongs (app, startSong, buf);
+		size_t matchCount;
+		bool fuzzy;
+		const size_t * const matches = BarUiFilter (settings, &filter, buf,
+				&matchCount, &fuzzy);
+		for (size_t i = 0; i < matchCount; i++) {
+			BarUiListSong (app, songs[matches[i]], matches[i]);
+		}
 
 		BarUiMsg (settings, MSG_QUESTION, "Select song: ");
 		if (BarReadlineStr (buf, sizeof (buf), input, BAR_RL_DEFAULT) == 0) {
-			return NULL;
+			break;
 		}
 
 		if (isnumeric (buf)) {
 			unsigned long i = strtoul (buf, NULL, 0);
-			tmpSong = PianoListGetP (startSong, i);
+			if (i < songCount) {
+				tmpSong = songs[i];
+			}
 		}
 	} while (tmpSong == NULL);
 
+	BarFilterDestroy (&filter);
+	free (songs);
 	return tmpSong;
 }
 
+/*	let user pick one song
+ *	@param app
+ *	@param song list
+ *	@param input fds
+ *	@return pointer to selected item in song list or NULL
+ */
+PianoSong_t *BarUiSelectSong (const BarApp_t * const app,
+		PianoSong_t *startSong, BarReadlineFds_t *input) {
+	return BarUiSelectSongFrom (app, startSong, NULL, input);
+}
+
+/*	let user pick one song from history
+ *	@param app
+ *	@param history
+ *	@param input fds
+ *	@return pointer to selected song or NULL
+ */
+PianoSong_t *BarUiSelectHistorySong (const BarApp_t * const app,
+		const BarHistory_t * const history, BarReadlineFds_t *input) {
+	return BarUiSelectSongFrom (app, NULL, history, input);
+}
+
 /*	let user pick one artist
  *	@param app handle
  *	@param artists (linked list)
  *	@return pointer to selected artist or NULL on abort
  */
 PianoArtist_t *BarUiSelectArtist (BarApp_t *app, PianoArtist_t *startArtist) {
-	PianoArtist_t *tmpArtist = NULL;
+	PianoArtist_t *tmpArtist = NULL, **artists;
+	size_t artistCount, i;
 	char buf[100];
-	unsigned long i;
+	BarFilter_t filter;
 
 	memset (buf, 0, sizeof (buf));
 
+	artistCount = PianoListCountP (startArtist);
+	artists = calloc (artistCount == 0 ? 1 : artistCount, sizeof (*artists));
+	if (artists == NULL) {
+		return NULL;
+	}
+	BarFilterInit (&filter);
+	i = 0;
+	tmpArtist = startArtist;
+	PianoListForeachP (tmpArtist) {
+		const char * const fields[] = {tmpArtist->name};
+		BarFilterAdd (&filter, fields, 1);
+		artists[i++] = tmpArtist;
+	}
+	tmpArtist = NULL;
+
 	do {
-		/* print all artists */
-		i = 0;
-		tmpArtist = startArtist;
-		PianoListForeachP (tmpArtist) {
-			if (BarStrCaseStr (tmpArtist->name, buf) != NULL) {
-				BarUiMsg (&app->settings, MSG_LIST, "%2lu) %s\n", i,
-						tmpArtist->name);
-			}
-			i++;
+		size_t matchCount;
+		bool fuzzy;
+		/* print matching artists */
+		const size_t * const matches = BarUiFilter (&app->settings, &filter,
+				buf, &matchCount, &fuzzy);
+		for (i = 0; i < matchCount; i++) {
+			BarUiMsg (&app->settings, MSG_LIST, "%2zu) %s\n", matches[i],
+					artists[matches[i]]->name);
 		}
 
 		BarUiMsg (&app->settings, MSG_QUESTION, "Select artist: ");
 		if (BarReadlineStr (buf, sizeof (buf), &app->input,
 				BAR_RL_DEFAULT) == 0) {
-			return NULL;
+			break;
 		}
 
 		if (isnumeric (buf)) {
-			i = strtoul (buf, NULL, 0);
-			tmpArtist = PianoListGetP (startArtist, i);
+			const unsigned long selected = strtoul (buf, NULL, 0);
+			if (selected < artistCount) {
+				tmpArtist = artists[selected];
+			}
 		}
 	} while (tmpArtist == NULL);
 
+	BarFilterDestroy (&filter);
+	free (artists);
 	return tmpArtist;
 }
 
@@ -770,53 +1295,54 @@ void BarUiPrintSong (const BarSettings_t *settings,
 	BarUiMsg (settings, MSG_PLAYING, "%s", outstr);
 }
 
+/*	Print song with index i
+ */
+static void BarUiListSong (const BarApp_t * const app,
+		const PianoSong_t * const song, const size_t i) {
+	const BarSettings_t * const settings = &app->settings;
+	const char * const deleted = "(deleted)", * const empty = "";
+	const char *stationName = empty;
+
+	const PianoStation_t * const station =
+			PianoFindStationById (&app->ph, song->stationId);
+	if (station != NULL && station != app->curStation) {
+		stationName = station->name;
+	} else if (station == NULL && song->stationId != NULL) {
+		stationName = deleted;
+	}
+
+	char outstr[512], digits[8], duration[8] = "??:??";
+	const char *vals[] = {digits, song->artist, song->title,
+			ratingToIcon (settings, song),
+			duration,
+			stationName != empty ? settings->atIcon : "",
+			stationName,
+			};
+
+	/* pre-format a few strings */
+	snprintf (digits, sizeof (digits) / sizeof (*digits), "%2zu", i);
+	const unsigned int length = song->length;
+	if (length > 0) {
+		snprintf (duration, sizeof (duration), "%02u:%02u",
+				length / 60, length % 60);
+	}
+
+	BarUiCustomFormat (outstr, sizeof (outstr), settings->listSongFormat,
+			"iatrd@s", vals);
+	BarUiAppendNewline (outstr, sizeof (outstr));
+	BarUiMsg (settings, MSG_LIST, "%s", outstr);
+}
+
 /*	Print list of songs
  *	@param pianobar settings
  *	@param linked list of songs
- *	@param artist/song filter string
  *	@return # of songs
  */
-size_t BarUiListSongs (const BarApp_t * const app,
-		const PianoSong_t *song, const char *filter) {
-	const BarSettings_t * const settings = &app->settings;
+size_t BarUiListSongs (const BarApp_t * const app, const PianoSong_t *song) {
 	size_t i = 0;
 
 	PianoListForeachP (song) {
-		if (filter == NULL ||
-				(filter != NULL && (BarStrCaseStr (song->artist, filter) != NULL ||
-				BarStrCaseStr (song->title, filter) != NULL))) {
-			const char * const deleted = "(deleted)", * const empty = "";
-			const char *stationName = empty;
-
-			const PianoStation_t * const station =
-					PianoFindStationById (app->ph.stations, song->stationId);
-			if (station != NULL && station != app->curStation) {
-				stationName = station->name;
-			} else if (station == NULL && song->stationId != NULL) {
-				stationName = deleted;
-			}
-
-			char outstr[512], digits[8], duration[8] = "??:??";
-			const char *vals[] = {digits, song->artist, song->title,
-					ratingToIcon (settings, song),
-					duration,
-					stationName != empty ? settings->atIcon : "",
-					stationName,
-					};
-
-			/* pre-format a few strings */
-			snprintf (digits, sizeof (digits) / sizeof (*digits), "%2zu", i);
-			const unsigned int length = song->length;
-			if (length > 0) {
-				snprintf (duration, sizeof (duration), "%02u:%02u",
-						length / 60, length % 60);
-			}
-
-			BarUiCustomFormat (outstr, sizeof (outstr), settings->listSongFormat,
-					"iatrd@s", vals);
-			BarUiAppendNewline (outstr, sizeof (outstr));
-			BarUiMsg (settings, MSG_LIST, "%s", outstr);
-		}
+		BarUiListSong (app, song, i);
 		i++;
 	}
 
@@ -828,17 +1354,20 @@ size_t BarUiListSongs (const BarApp_t * const app,
  *	@param event type
  *	@param current station
  *	@param current song
+ *	@param player
+ *	@param piano handle, station list is sent if not NULL
  *	@param piano error-code (PIANO_RET_OK if not applicable)
  */
 void BarUiStartEventCmd (const BarSettings_t *settings, const char *type,
 		const PianoStation_t *curStation, const PianoSong_t *curSong,
-		player_t * const player, PianoStation_t *stations,
+		player_t * const player, const PianoHandle_t * const ph,
 		PianoReturn_t pRet, CURLcode wRet) {
 	pid_t chld;
 	int pipeFd[2];
+	PianoStation_t * const stations = ph == NULL ? NULL : ph->stations;
 
 	/* This function is a handy place to know when detail strings have changed. */
-	BarShmemSetStrings(curStation, curSong, stations);
+	BarShmemSetStrings(curStation, curSong, ph);
 
 	if (settings->eventCmd == NULL) {
 		/* nothing to do... */
@@ -873,7 +1402,7 @@ void BarUiStartEventCmd (const BarSettings_t *settings, const char *type,
 
 		if (curSong != NULL && stations != NULL && curStation != NULL &&
 				curStation->isQuickMix) {
-			songStation = PianoFindStationById (stations, curSong->stationId);
+			songStation = PianoFindStationById (ph, curSong->stationId);
 		}
 
 		pthread_mutex_lock (&player->lock);
@@ -939,29 +1468,3 @@ void BarUiStartEventCmd (const BarSettings_t *settings, const char *type,
 		waitpid (chld, &status, 0);
 	}
 }
-
-/*	prepend song to history
- */
-void BarUiHistoryPrepend (BarApp_t *app, PianoSong_t *song) {
-	assert (app != NULL);
-	assert (song != NULL);
-	/* make sure it's a single song */
-	assert (PianoListNextP (song) == NULL);
-
-	if (app->settings.history != 0) {
-		app->songHistory = PianoListPrependP (app->songHistory, song);
-		PianoSong_t *del;
-		do {
-			del = PianoListGetP (app->songHistory, app->settings.history);
-			if (del != NULL) {
-				app->songHistory = PianoListDeleteP (app->songHistory, del);
-				PianoDestroyPlaylist (del);
-			} else {
-				break;
-			}
-		} while (true);
-	} else {
-		PianoDestroyPlaylist (song);
-	}
-}
-
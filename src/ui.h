@@ -41,19 +41,32 @@ PianoStation_t *BarUiSelectStation (BarApp_t *, PianoStation_t *, const char *,
 		BarUiSelectStationCallback_t, bool);
 PianoSong_t *BarUiSelectSong (const BarApp_t * const app,
 		PianoSong_t *startSong, BarReadlineFds_t *input);
+PianoSong_t *BarUiSelectHistorySong (const BarApp_t * const,
+		const BarHistory_t * const, BarReadlineFds_t *);
 PianoArtist_t *BarUiSelectArtist (BarApp_t *, PianoArtist_t *);
 char *BarUiSelectMusicId (BarApp_t *, PianoStation_t *, const char *);
 void BarUiPrintStation (const BarSettings_t *, PianoStation_t *);
 void BarUiPrintSong (const BarSettings_t *, const PianoSong_t *, 
 		const PianoStation_t *);
-size_t BarUiListSongs (const BarApp_t * const app,
-		const PianoSong_t *song, const char *filter);
+size_t BarUiListSongs (const BarApp_t * const app, const PianoSong_t *song);
 void BarUiStartEventCmd (const BarSettings_t *, const char *,
 		const PianoStation_t *, const PianoSong_t *, player_t *,
-		PianoStation_t *, PianoReturn_t, CURLcode);
+		const PianoHandle_t *, PianoReturn_t, CURLcode);
 bool BarUiPianoCall (BarApp_t * const, const PianoRequestType_t,
 		void *, PianoReturn_t *, CURLcode *);
-void BarUiHistoryPrepend (BarApp_t *app, PianoSong_t *song);
+typedef void (*BarUiPianoCallback_t) (BarApp_t * const,
+		const PianoRequestType_t, void * const, const PianoReturn_t,
+		const CURLcode, void * const);
+bool BarUiPianoCallAsync (BarApp_t * const, const PianoRequestType_t,
+		void * const, BarUiPianoCallback_t, void * const, const bool);
+void BarUiPianoDispatch (BarApp_t * const);
+bool BarUiPianoCallCached (BarApp_t * const, const PianoRequestType_t,
+		void * const, PianoReturn_t * const, CURLcode * const);
+void BarUiCacheDropStationInfo (BarApp_t * const, const char * const);
+void BarUiPianoCancel (BarApp_t * const);
+void BarUiFeedbackQueue (BarApp_t * const, const BarFeedbackType_t,
+		PianoSong_t * const);
+void BarUiFeedbackFlush (BarApp_t * const);
 void BarUiCustomFormat (char *dest, size_t destSize, const char *format,
 		const char *formatChars, const char **formatVals);
 
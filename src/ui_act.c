@@ -38,7 +38,7 @@ THE SOFTWARE.
 /*	standard eventcmd call
  */
 #define BarUiActDefaultEventcmd(name) BarUiStartEventCmd (&app->settings, \
-		name, selStation, selSong, &app->player, app->ph.stations, \
+		name, selStation, selSong, &app->player, &app->ph, \
 		pRet, wRet)
 
 /*	standard piano call
@@ -127,15 +127,13 @@ BarUiActCallback(BarUiActAddMusic) {
 /*	ban song
  */
 BarUiActCallback(BarUiActBanSong) {
-	PianoReturn_t pRet;
-	CURLcode wRet;
 	PianoStation_t *realStation;
 
 	assert (selStation != NULL);
 	assert (selSong != NULL);
 	assert (selSong->stationId != NULL);
 
-	if ((realStation = PianoFindStationById (app->ph.stations,
+	if ((realStation = PianoFindStationById (&app->ph,
 			selSong->stationId)) == NULL) {
 		assert (0);
 		return;
@@ -144,16 +142,11 @@ BarUiActCallback(BarUiActBanSong) {
 		return;
 	}
 
-	PianoRequestDataRateSong_t reqData;
-	reqData.song = selSong;
-	reqData.rating = PIANO_RATE_BAN;
-
 	BarUiMsg (&app->settings, MSG_INFO, "Banning song... ");
-	if (BarUiActDefaultPianoCall (PIANO_REQUEST_RATE_SONG, &reqData) &&
-			selSong == app->playlist) {
+	BarUiFeedbackQueue (app, BAR_FB_BAN, selSong);
+	if (selSong == app->playlist) {
 		BarUiDoSkipSong (&app->player);
 	}
-	BarUiActDefaultEventcmd ("songban");
 }
 
 /*	create new station
@@ -289,8 +282,8 @@ BarUiActCallback(BarUiActStationFromGenre) {
 	/* receive genre stations list if not yet available */
 	if (app->ph.genreStations == NULL) {
 		BarUiMsg (&app->settings, MSG_INFO, "Receiving genre stations... ");
-		const bool ret = BarUiActDefaultPianoCall (
-				PIANO_REQUEST_GET_GENRE_STATIONS, NULL);
+		const bool ret = BarUiPianoCallCached (app,
+				PIANO_REQUEST_GET_GENRE_STATIONS, NULL, &pRet, &wRet);
 		BarUiActDefaultEventcmd ("stationfetchgenre");
 		if (!ret) {
 			return;
@@ -350,7 +343,7 @@ BarUiActCallback(BarUiActSongInfo) {
 	/* print real station if quickmix */
 	BarUiPrintSong (&app->settings, selSong,
 			selStation->isQuickMix ?
-			PianoFindStationById (app->ph.stations, selSong->stationId) :
+			PianoFindStationById (&app->ph, selSong->stationId) :
 			NULL);
 }
 
@@ -385,20 +378,122 @@ BarUiActCallback(BarUiActDebug) {
 			selSong->stationId,
 			selSong->title,
 			selSong->trackToken);
+	BarUiMsg (&app->settings, MSG_NONE,
+			"rpcRequests:\t%lu\n"
+			"rpcReused:\t%lu\n"
+			"rpcParseTime:\t%.3fs\n"
+			"rpcMaxResponse:\t%zu\n"
+			"rpcMaxPeak:\t%zu\n"
+			"rpcRetries:\t%lu\n"
+			"rpcFastFails:\t%lu\n"
+			"rpcArenaAllocs:\t%lu\n"
+			"rpcArenaBlocks:\t%lu\n"
+			"feedbackDepth:\t%zu\n"
+			"feedbackFlushed:\t%lu\n"
+			"feedbackFailed:\t%lu\n"
+			"feedbackLatency:\t%.0fs (avg %.1fs)\n",
+			app->rpc.requests,
+			app->rpc.reused,
+			app->rpc.parseTime,
+			app->rpc.maxResponse,
+			app->rpc.maxPeak,
+			app->rpc.retry.retries,
+			app->rpc.retry.fastFails,
+			app->rpc.arenaAllocs,
+			app->rpc.arenaBlocks,
+			app->feedback.depth,
+			app->feedback.flushed,
+			app->feedback.failed,
+			app->feedback.lastLatency,
+			app->feedback.flushed > 0 ?
+			app->feedback.totalLatency / app->feedback.flushed : 0.0);
+}
+
+/*	write metrics atomically, in prometheus’ text format
+ */
+static bool BarUiActWriteMetrics (const BarApp_t * const app,
+		const char * const path) {
+	char tmpPath[1024];
+	snprintf (tmpPath, sizeof (tmpPath), "%s.tmp", path);
+	FILE * const fd = fopen (tmpPath, "w");
+	if (fd == NULL) {
+		return false;
+	}
+
+	BarMetricsWrite (&app->rpc.metrics, fd);
+	BarMetricsWriteValue (fd, "pianobar_rpc_reused_connections_total",
+			"counter", "Transfers that reused a connection.",
+			app->rpc.reused);
+	BarMetricsWriteValue (fd, "pianobar_rpc_fast_fails_total", "counter",
+			"Calls rejected by an open circuit breaker.",
+			app->rpc.retry.fastFails);
+	BarMetricsWriteValue (fd, "pianobar_rpc_arena_allocations_total",
+			"counter", "Arena allocations for requests and responses.",
+			app->rpc.arenaAllocs);
+	BarMetricsWriteValue (fd, "pianobar_rpc_arena_blocks_total", "counter",
+			"Memory blocks allocated by arenas.", app->rpc.arenaBlocks);
+	BarMetricsWriteValue (fd, "pianobar_cache_hits_total", "counter",
+			"Responses served from the cache.", app->cache.hits);
+	BarMetricsWriteValue (fd, "pianobar_cache_misses_total", "counter",
+			"Responses not found in the cache.", app->cache.misses);
+	BarMetricsWriteValue (fd, "pianobar_feedback_queue_depth", "gauge",
+			"Feedback operations waiting to be sent.", app->feedback.depth);
+	BarMetricsWriteValue (fd, "pianobar_feedback_flushed_total", "counter",
+			"Feedback operations accepted by pandora.",
+			app->feedback.flushed);
+	BarMetricsWriteValue (fd, "pianobar_feedback_failed_total", "counter",
+			"Feedback operations dropped.", app->feedback.failed);
+
+	if (fclose (fd) != 0 || rename (tmpPath, path) != 0) {
+		unlink (tmpPath);
+		return false;
+	}
+	return true;
+}
+
+/*	print rpc latency summary and write all metrics to metrics_file
+ */
+BarUiActCallback(BarUiActMetrics) {
+	const BarMetrics_t * const m = &app->rpc.metrics;
+
+	BarUiMsg (&app->settings, MSG_NONE, "%-18s %6s %6s %8s %8s %8s\n",
+			"method", "calls", "errors", "p50", "p95", "max");
+	for (size_t i = 0; i < BAR_METRICS_TYPES; i++) {
+		const BarMethodMetrics_t * const mm = m->methods[i];
+		if (mm == NULL) {
+			continue;
+		}
+		const BarHistogram_t * const h = &mm->phases[BAR_MP_TOTAL];
+		BarUiMsg (&app->settings, MSG_LIST, "%-18s %6lu %6lu %6.0fms "
+				"%6.0fms %6.0fms\n", BarMetricsMethodName (i), mm->calls,
+				mm->networkErrors + mm->pandoraErrors,
+				BarHistogramPercentile (h, 0.5) / 1000.0,
+				BarHistogramPercentile (h, 0.95) / 1000.0,
+				h->max / 1000.0);
+	}
+
+	if (app->settings.metricsFile == NULL) {
+		return;
+	}
+	if (BarUiActWriteMetrics (app, app->settings.metricsFile)) {
+		BarUiMsg (&app->settings, MSG_INFO, "Metrics written to %s\n",
+				app->settings.metricsFile);
+	} else {
+		BarUiMsg (&app->settings, MSG_ERR, "Cannot write metrics to %s\n",
+				app->settings.metricsFile);
+	}
 }
 
 /*	rate current song
  */
 BarUiActCallback(BarUiActLoveSong) {
-	PianoReturn_t pRet;
-	CURLcode wRet;
 	PianoStation_t *realStation;
 
 	assert (selStation != NULL);
 	assert (selSong != NULL);
 	assert (selSong->stationId != NULL);
 
-	if ((realStation = PianoFindStationById (app->ph.stations,
+	if ((realStation = PianoFindStationById (&app->ph,
 			selSong->stationId)) == NULL) {
 		assert (0);
 		return;
@@ -407,13 +502,8 @@ BarUiActCallback(BarUiActLoveSong) {
 		return;
 	}
 
-	PianoRequestDataRateSong_t reqData;
-	reqData.song = selSong;
-	reqData.rating = PIANO_RATE_LOVE;
-
 	BarUiMsg (&app->settings, MSG_INFO, "Loving song... ");
-	BarUiActDefaultPianoCall (PIANO_REQUEST_RATE_SONG, &reqData);
-	BarUiActDefaultEventcmd ("songlove");
+	BarUiFeedbackQueue (app, BAR_FB_LOVE, selSong);
 }
 
 /*	skip song
@@ -488,17 +578,14 @@ BarUiActCallback(BarUiActSelectStation) {
 /*	ban song for 1 month
  */
 BarUiActCallback(BarUiActTempBanSong) {
-	PianoReturn_t pRet;
-	CURLcode wRet;
 
 	assert (selSong != NULL);
 
 	BarUiMsg (&app->settings, MSG_INFO, "Putting song on shelf... ");
-	if (BarUiActDefaultPianoCall (PIANO_REQUEST_ADD_TIRED_SONG, selSong) &&
-			selSong == app->playlist) {
+	BarUiFeedbackQueue (app, BAR_FB_TIRED, selSong);
+	if (selSong == app->playlist) {
 		BarUiDoSkipSong (&app->player);
 	}
-	BarUiActDefaultEventcmd ("songshelf");
 }
 
 /*	print upcoming songs
@@ -506,7 +593,7 @@ BarUiActCallback(BarUiActTempBanSong) {
 BarUiActCallback(BarUiActPrintUpcoming) {
 	PianoSong_t * const nextSong = PianoListNextP (selSong);
 	if (nextSong != NULL) {
-		BarUiListSongs (app, nextSong, NULL);
+		BarUiListSongs (app, nextSong);
 	} else {
 		BarUiMsg (&app->settings, MSG_INFO, "No songs in queue.\n");
 	}
@@ -587,12 +674,12 @@ BarUiActCallback(BarUiActHistory) {
 	char buf[2];
 	PianoSong_t *histSong;
 
-	if (app->songHistory != NULL) {
-		histSong = BarUiSelectSong (app, app->songHistory,
+	if (app->history.count > 0) {
+		histSong = BarUiSelectHistorySong (app, &app->history,
 				&app->input);
 		if (histSong != NULL) {
 			BarKeyShortcutId_t action;
-			PianoStation_t *songStation = PianoFindStationById (app->ph.stations,
+			PianoStation_t *songStation = PianoFindStationById (&app->ph,
 					histSong->stationId);
 
 			if (songStation == NULL) {
@@ -623,8 +710,6 @@ BarUiActCallback(BarUiActHistory) {
 /*	create song bookmark
  */
 BarUiActCallback(BarUiActBookmark) {
-	PianoReturn_t pRet;
-	CURLcode wRet;
 	char selectBuf[2];
 
 	assert (selSong != NULL);
@@ -634,12 +719,10 @@ BarUiActCallback(BarUiActBookmark) {
 			BAR_RL_FULLRETURN, -1);
 	if (selectBuf[0] == 's') {
 		BarUiMsg (&app->settings, MSG_INFO, "Bookmarking song... ");
-		BarUiActDefaultPianoCall (PIANO_REQUEST_BOOKMARK_SONG, selSong);
-		BarUiActDefaultEventcmd ("songbookmark");
+		BarUiFeedbackQueue (app, BAR_FB_BOOKMARK_SONG, selSong);
 	} else if (selectBuf[0] == 'a') {
 		BarUiMsg (&app->settings, MSG_INFO, "Bookmarking artist... ");
-		BarUiActDefaultPianoCall (PIANO_REQUEST_BOOKMARK_ARTIST, selSong);
-		BarUiActDefaultEventcmd ("artistbookmark");
+		BarUiFeedbackQueue (app, BAR_FB_BOOKMARK_ARTIST, selSong);
 	}
 }
 
@@ -772,13 +855,14 @@ BarUiActCallback(BarUiActManageStation) {
 	PianoRequestDataGetStationInfo_t reqData;
 	char selectBuf[2], allowedActions[6], *allowedPos = allowedActions;
 	char question[128];
+	bool modified = false;
 
 	memset (&reqData, 0, sizeof (reqData));
 	reqData.station = selStation;
 
 	BarUiMsg (&app->settings, MSG_INFO, "Fetching station info... ");
-	const bool bret = BarUiActDefaultPianoCall (PIANO_REQUEST_GET_STATION_INFO,
-			&reqData);
+	const bool bret = BarUiPianoCallCached (app,
+			PIANO_REQUEST_GET_STATION_INFO, &reqData, &pRet, &wRet);
 	BarUiActDefaultEventcmd ("stationfetchinfo");
 	if (!bret) {
 		return;
@@ -838,7 +922,8 @@ BarUiActCallback(BarUiActManageStation) {
 				subReqData.artist = artist;
 
 				BarUiMsg (&app->settings, MSG_INFO, "Deleting artist seed... ");
-				BarUiActDefaultPianoCall (PIANO_REQUEST_DELETE_SEED, &subReqData);
+				modified = BarUiActDefaultPianoCall (PIANO_REQUEST_DELETE_SEED,
+						&subReqData);
 				BarUiActDefaultEventcmd ("stationdeleteartistseed");
 			}
 		} else if (selectBuf[0] == 's') {
@@ -851,7 +936,8 @@ BarUiActCallback(BarUiActManageStation) {
 				subReqData.song = song;
 
 				BarUiMsg (&app->settings, MSG_INFO, "Deleting song seed... ");
-				BarUiActDefaultPianoCall (PIANO_REQUEST_DELETE_SEED, &subReqData);
+				modified = BarUiActDefaultPianoCall (PIANO_REQUEST_DELETE_SEED,
+						&subReqData);
 				BarUiActDefaultEventcmd ("stationdeletesongseed");
 			}
 		} else if (selectBuf[0] == 't') {
@@ -865,7 +951,8 @@ BarUiActCallback(BarUiActManageStation) {
 				subReqData.station = station;
 
 				BarUiMsg (&app->settings, MSG_INFO, "Deleting station seed... ");
-				BarUiActDefaultPianoCall (PIANO_REQUEST_DELETE_SEED, &subReqData);
+				modified = BarUiActDefaultPianoCall (PIANO_REQUEST_DELETE_SEED,
+						&subReqData);
 				BarUiActDefaultEventcmd ("stationdeletestationseed");
 			}
 		} else if (selectBuf[0] == 'f') {
@@ -873,7 +960,8 @@ BarUiActCallback(BarUiActManageStation) {
 					reqData.info.feedback, &app->input);
 			if (song != NULL) {
 				BarUiMsg (&app->settings, MSG_INFO, "Deleting feedback... ");
-				BarUiActDefaultPianoCall (PIANO_REQUEST_DELETE_FEEDBACK, song);
+				modified = BarUiActDefaultPianoCall (
+						PIANO_REQUEST_DELETE_FEEDBACK, song);
 				BarUiActDefaultEventcmd ("stationdeletefeedback");
 			}
 		} else if (selectBuf[0] == 'm') {
@@ -920,5 +1008,41 @@ BarUiActCallback(BarUiActManageStation) {
 		}
 	}
 
+	if (modified) {
+		BarUiCacheDropStationInfo (app, selStation->id);
+	}
+
 	PianoDestroyStationInfo (&reqData.info);
 }
+
+/*	change user dsp chain (libav filter graph)
+ */
+BarUiActCallback(BarUiActDspChain) {
+	char lineBuf[512];
+
+	if (app->settings.dspChain != NULL && app->settings.dspChain[0] != '\0') {
+		BarUiMsg (&app->settings, MSG_INFO, "Current filters: %s\n",
+				app->settings.dspChain);
+	}
+	BarUiMsg (&app->settings, MSG_QUESTION, "New filters (- to disable): ");
+	if (BarReadlineStr (lineBuf, sizeof (lineBuf), &app->input,
+			BAR_RL_DEFAULT) == 0) {
+		/* aborted, keep the current filters */
+		return;
+	}
+	if (strcmp (lineBuf, "-") == 0) {
+		lineBuf[0] = '\0';
+	}
+
+	if (!BarPlayerSetDspChain (&app->player, lineBuf)) {
+		/* error message printed by player */
+		return;
+	}
+
+	char * const chain = strdup (lineBuf);
+	pthread_mutex_lock (&app->player.lock);
+	char * const oldChain = app->settings.dspChain;
+	app->settings.dspChain = chain;
+	pthread_mutex_unlock (&app->player.lock);
+	free (oldChain);
+}
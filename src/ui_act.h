@@ -54,6 +54,7 @@ BarUiActCallback(BarUiActPrintUpcoming);
 BarUiActCallback(BarUiActSelectQuickMix);
 BarUiActCallback(BarUiActQuit);
 BarUiActCallback(BarUiActDebug);
+BarUiActCallback(BarUiActMetrics);
 BarUiActCallback(BarUiActHistory);
 BarUiActCallback(BarUiActBookmark);
 BarUiActCallback(BarUiActVolDown);
@@ -61,4 +62,5 @@ BarUiActCallback(BarUiActVolUp);
 BarUiActCallback(BarUiActManageStation);
 BarUiActCallback(BarUiActVolReset);
 BarUiActCallback(BarUiActSettings);
+BarUiActCallback(BarUiActDspChain);
 
@@ -104,6 +104,10 @@ static const BarUiDispatchAction_t dispatchActions[BAR_KS_COUNT] = {
 				"act_volreset"},
 		{'!', BAR_DC_GLOBAL, BarUiActSettings, "change settings",
 				"act_settings"},
+		{'f', BAR_DC_GLOBAL, BarUiActDspChain, "change audio filters",
+				"act_dspchain"},
+		{'%', BAR_DC_GLOBAL, BarUiActMetrics, "show and write rpc metrics",
+				"act_metrics"},
 		};
 
 #include <piano.h>
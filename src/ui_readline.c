@@ -21,11 +21,14 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
 
+#include "config.h"
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 #include <assert.h>
+#include <time.h>
 
 #include "ui_readline.h"
 #include "main.h"
@@ -73,30 +76,70 @@ size_t BarReadline (char *buf, const size_t bufSize, const char *mask,
 
 	memset (buf, 0, bufSize);
 
+	/* absolute timeout, select may return early because of rpc transfers */
+	struct timespec deadline;
+	clock_gettime (CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += timeout;
+
 	/* if fd is a fifo fgetc will always return EOF if nobody writes to
 	 * it, stdin will block */
 	while (!done) {
 		int curFd = -1;
 		unsigned char chr;
 		struct timeval timeoutstruct;
+		fd_set writeSet, exceptSet;
+		int maxfd = input->maxfd;
+		long waitMs = -1;
+
+		if (timeout != -1) {
+			struct timespec now;
+			clock_gettime (CLOCK_MONOTONIC, &now);
+			waitMs = (deadline.tv_sec - now.tv_sec) * 1000 +
+					(deadline.tv_nsec - now.tv_nsec) / 1000000;
+			if (waitMs <= 0) {
+				/* timeout */
+				bufLen = 0;
+				break;
+			}
+		}
 
 		/* select modifies set and timeout */
 		memcpy (&set, &input->set, sizeof (set));
-		timeoutstruct.tv_sec = timeout;
-		timeoutstruct.tv_usec = 0;
+		FD_ZERO (&writeSet);
+		FD_ZERO (&exceptSet);
+		if (input->rpc != NULL) {
+			BarRpcFdset (input->rpc, &set, &writeSet, &exceptSet, &maxfd,
+					&waitMs);
+		}
+		timeoutstruct.tv_sec = waitMs / 1000;
+		timeoutstruct.tv_usec = (waitMs % 1000) * 1000;
 
-		if (select (input->maxfd, &set, NULL, NULL,
-				(timeout == -1) ? NULL : &timeoutstruct) <= 0) {
-			/* timeout or interrupted */
+		const int ret = select (maxfd, &set, &writeSet, &exceptSet,
+				(waitMs == -1) ? NULL : &timeoutstruct);
+		if (ret < 0) {
+			/* interrupted */
 			bufLen = 0;
 			break;
 		}
 
+		if (input->rpc != NULL) {
+			BarRpcPerform (input->rpc);
+			/* let the main loop handle finished requests */
+			if (timeout != -1 && BarRpcHasDone (input->rpc)) {
+				bufLen = 0;
+				break;
+			}
+		}
+
 		assert (sizeof (input->fds) / sizeof (*input->fds) == 2);
-		if (FD_ISSET(input->fds[0], &set)) {
+		if (ret > 0 && FD_ISSET(input->fds[0], &set)) {
 			curFd = input->fds[0];
-		} else if (input->fds[1] != -1 && FD_ISSET(input->fds[1], &set)) {
+		} else if (ret > 0 && input->fds[1] != -1 &&
+				FD_ISSET(input->fds[1], &set)) {
 			curFd = input->fds[1];
+		} else {
+			/* timeout or rpc activity only */
+			continue;
 		}
 		if (read (curFd, &chr, sizeof (chr)) <= 0) {
 			/* select() is going wild if fdset contains EOFed stdin, only check
@@ -26,6 +26,8 @@ THE SOFTWARE.
 #include <stdbool.h>
 #include <sys/select.h>
 
+#include "rpc.h"
+
 /* bitfield */
 typedef enum {
 	BAR_RL_DEFAULT = 0,
@@ -38,6 +40,8 @@ typedef struct {
 	fd_set set;
 	int maxfd;
 	int fds[2];
+	/* transfers make progress while waiting for input, may be NULL */
+	BarRpc_t *rpc;
 } BarReadlineFds_t;
 
 size_t BarReadline (char *, const size_t, const char *,